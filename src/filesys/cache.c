@@ -1,5 +1,7 @@
 #include "filesys/cache.h"
+#include <string.h>
 #ifdef PRJ4
+#include "threads/thread.h"
 
 struct file_cache
 {
@@ -7,6 +9,7 @@ struct file_cache
   uint32_t sector_no;
   bool accessed;
   bool dirty;
+  bool meta;                    /* Dirty metadata, see below. */
   struct lock buffer_lock;
   uint8_t data[DISK_SECTOR_SIZE];
 };
@@ -14,10 +17,44 @@ struct file_cache
 static struct file_cache buffer_cache[BUFFER_CACHE_SIZE];
 static uint32_t lookup_start_index;
 
+/* Locking.
+
+   cache_lock guards which sector each slot holds (allocated and
+   sector_no) and the clock hand.  Each slot's buffer_lock guards
+   its data and dirty bit, and is held by whoever is reading the
+   slot in from disk, so a thread that finds a slot still being
+   loaded waits on the slot, not on the whole cache.  A slot only
+   changes sector while both locks are held.
+
+   Nothing waits for a buffer_lock while holding cache_lock: it
+   only ever tries for them.  That way a thread holding one slot
+   may look up a second one, as buffer_cache_copy() does.
+
+   Writing back a dirty victim happens under cache_lock, so that
+   nobody can read the victim's old sector back in from disk
+   before the new data is written there.
+
+   Slots written with buffer_cache_write_meta() hold metadata
+   that the journal has not committed yet.  Writing one in place
+   early could leave a half-done operation on disk, so they are
+   skipped by eviction and write-back alike and reach the disk
+   through buffer_cache_log() and buffer_cache_checkpoint().
+   Only if every slot holds such metadata does eviction write
+   one in place anyway. */
+static struct lock cache_lock;
+
+static int buffer_cache_find_victim (void);
+static int buffer_cache_lookup (disk_sector_t);
+static int buffer_cache_get (disk_sector_t, bool);
+static int buffer_cache_lock_slot (disk_sector_t);
+static void buffer_cache_put (disk_sector_t, const void *, off_t, off_t,
+                              bool);
+
 void
 buffer_cache_init (void)
 {
   uint32_t i = 0;
+  lock_init (&cache_lock);
   for (i = 0; i < BUFFER_CACHE_SIZE; i++)
   {
     buffer_cache[i].sector_no = 0;
@@ -27,138 +64,331 @@ buffer_cache_init (void)
   lookup_start_index = 0;
 }
 
-bool
-buffer_cache_release (disk_sector_t sec_no)
+/* Returns the slot holding SEC_NO with both cache_lock and its
+   buffer_lock held, or -1 with neither held if SEC_NO is not
+   cached. */
+static int
+buffer_cache_lock_slot (disk_sector_t sec_no)
 {
-  uint32_t i = 0;
-  for (i = 0; i < BUFFER_CACHE_SIZE; i++)
+  int i;
+
+  for (;;)
   {
-    if (buffer_cache[i].sector_no == sec_no && buffer_cache[i].allocated)
+    lock_acquire (&cache_lock);
+    i = buffer_cache_lookup (sec_no);
+    if (i < 0)
     {
-      lock_acquire (&buffer_cache[i].buffer_lock);
-      if (buffer_cache[i].dirty)
-        disk_write (filesys_disk, buffer_cache[i].sector_no, &buffer_cache[i].data);
-      buffer_cache[i].allocated = false;
-      lock_release (&buffer_cache[i].buffer_lock);
-      return true;
+      lock_release (&cache_lock);
+      return -1;
     }
+    if (lock_try_acquire (&buffer_cache[i].buffer_lock))
+      return i;
+
+    /* Wait for the slot's holder without keeping the cache
+       locked, then look again. */
+    lock_release (&cache_lock);
+    lock_acquire (&buffer_cache[i].buffer_lock);
+    lock_release (&buffer_cache[i].buffer_lock);
   }
-  return false;
 }
 
-/* return the index of new victim from buffer_cache */
-uint32_t
+bool
+buffer_cache_release (disk_sector_t sec_no)
+{
+  int i = buffer_cache_lock_slot (sec_no);
+
+  if (i < 0)
+    return false;
+  /* The old content of freed metadata stays on disk until the
+     journal commits the free. */
+  if (buffer_cache[i].dirty && !buffer_cache[i].meta)
+    disk_write (filesys_disk, buffer_cache[i].sector_no, &buffer_cache[i].data);
+  buffer_cache[i].allocated = false;
+  lock_release (&buffer_cache[i].buffer_lock);
+  lock_release (&cache_lock);
+  return true;
+}
+
+/* Writes SEC_NO back to disk if it is cached and dirty, and
+   keeps it cached.  Metadata is left for the journal. */
+void
+buffer_cache_flush (disk_sector_t sec_no)
+{
+  int i = buffer_cache_lock_slot (sec_no);
+
+  if (i < 0)
+    return;
+  lock_release (&cache_lock);
+  if (buffer_cache[i].dirty && !buffer_cache[i].meta)
+  {
+    disk_write (filesys_disk, sec_no, &buffer_cache[i].data);
+    buffer_cache[i].dirty = false;
+  }
+  lock_release (&buffer_cache[i].buffer_lock);
+}
+
+/* return the index of new victim from buffer_cache, with its
+   buffer_lock held, or -1 if every slot is in use right now.
+   cache_lock must be held. */
+static int
 buffer_cache_find_victim (void)
 {
-  uint32_t ans, i;
+  uint32_t i, step;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
   // 먼저 빈 캐시가 있는지부터 찾고 있으면 그 인덱스를 리턴
   for (i = 0; i < BUFFER_CACHE_SIZE; i++)
   {
-    if (!buffer_cache[i].allocated)
-    {
-      ans = i;
-      return ans;
-    }
+    if (!buffer_cache[i].allocated
+        && lock_try_acquire (&buffer_cache[i].buffer_lock))
+      return i;
   }
 
+  // 두 바퀴를 돌면 accessed가 모두 지워지므로 그 안에 찾는다.
+  // 커밋 안 된 메타데이터는 건너뛰고, 그것밖에 없을 때만 쓴다.
   i = lookup_start_index;
-  while (true)
+  for (step = 0; step < 3 * BUFFER_CACHE_SIZE; step++)
   {
-    if (buffer_cache[i].accessed)
+    if (lock_try_acquire (&buffer_cache[i].buffer_lock))
     {
-      lock_acquire (&buffer_cache[i].buffer_lock);
+      if (step >= 2 * BUFFER_CACHE_SIZE
+          || (!buffer_cache[i].accessed && !buffer_cache[i].meta))
+      {
+        lookup_start_index = (i + 1) % BUFFER_CACHE_SIZE;
+        return i;
+      }
       buffer_cache[i].accessed = false;
       lock_release (&buffer_cache[i].buffer_lock);
-      i = (i + 1) % BUFFER_CACHE_SIZE;
-    }
-    else
-    {
-      lookup_start_index = (i + 1) % BUFFER_CACHE_SIZE;
-      ans = i;
-      lock_acquire (&buffer_cache[i].buffer_lock);
-      // swapping out to file disk
-      if (buffer_cache[i].dirty)
-        disk_write (filesys_disk, buffer_cache[i].sector_no, &buffer_cache[i].data);
-      buffer_cache[ans].allocated = false;
-      lock_release (&buffer_cache[i].buffer_lock);
-      break;
     }
+    i = (i + 1) % BUFFER_CACHE_SIZE;
   }
-
-  return ans;
+  return -1;
 }
 
-void
-buffer_cache_read (disk_sector_t sec_no, void *buffer, off_t size, off_t offset)
+/* Returns the slot holding SEC_NO, or -1 if it is not cached.
+   cache_lock must be held. */
+static int
+buffer_cache_lookup (disk_sector_t sec_no)
 {
   uint32_t i;
-  int ans = -1;
-  // buffer_cache에 먼저 불러온 것이 있는지 검사
-  // 있으면 걍 그거로부터 읽음
   for (i = 0; i < BUFFER_CACHE_SIZE; i++)
-  {
     if (buffer_cache[i].sector_no == sec_no && buffer_cache[i].allocated)
+      return i;
+  return -1;
+}
+
+/* Returns the index of the buffer cache slot holding SEC_NO,
+   reading it in from disk if it is not cached yet, with the
+   slot's buffer_lock held.  If MAY_BLOCK is false, returns -1
+   instead of waiting for a slot that someone else holds. */
+static int
+buffer_cache_get (disk_sector_t sec_no, bool may_block)
+{
+  int ans;
+
+  for (;;)
+  {
+    lock_acquire (&cache_lock);
+    // buffer_cache에 먼저 불러온 것이 있는지 검사
+    // 있으면 걍 그거로부터 읽음
+    ans = buffer_cache_lookup (sec_no);
+    if (ans >= 0)
     {
-      ans = i;
-      break;
+      if (lock_try_acquire (&buffer_cache[ans].buffer_lock))
+      {
+        lock_release (&cache_lock);
+        buffer_cache[ans].accessed = true;
+        return ans;
+      }
+      lock_release (&cache_lock);
+      if (!may_block)
+        return -1;
+
+      /* The slot may hold another sector by the time we get it. */
+      lock_acquire (&buffer_cache[ans].buffer_lock);
+      if (buffer_cache[ans].allocated
+          && buffer_cache[ans].sector_no == sec_no)
+      {
+        buffer_cache[ans].accessed = true;
+        return ans;
+      }
+      lock_release (&buffer_cache[ans].buffer_lock);
+      continue;
     }
-  }
 
-  if (ans < 0)
-  {
     ans = buffer_cache_find_victim ();
-    lock_acquire (&buffer_cache[ans].buffer_lock);
-    disk_read (filesys_disk, sec_no, &buffer_cache[ans].data);
+    if (ans < 0)
+    {
+      lock_release (&cache_lock);
+      if (!may_block)
+        return -1;
+      thread_yield ();
+      continue;
+    }
+
+    // swapping out to file disk
+    if (buffer_cache[ans].allocated && buffer_cache[ans].dirty)
+      disk_write (filesys_disk, buffer_cache[ans].sector_no,
+                  &buffer_cache[ans].data);
     buffer_cache[ans].allocated = true;
     buffer_cache[ans].accessed = true;
+    buffer_cache[ans].dirty = false;
+    buffer_cache[ans].meta = false;
     buffer_cache[ans].sector_no = sec_no;
-    lock_release (&buffer_cache[ans].buffer_lock);
+    lock_release (&cache_lock);
+
+    /* Others looking for SEC_NO find the slot and wait on its
+       lock until it is read in. */
+    disk_read (filesys_disk, sec_no, &buffer_cache[ans].data);
+    return ans;
   }
+}
+
+void
+buffer_cache_read (disk_sector_t sec_no, void *buffer, off_t size, off_t offset)
+{
+  int ans = buffer_cache_get (sec_no, true);
 
   memcpy (buffer, (uint8_t*) &buffer_cache[ans].data + offset, size);
+  lock_release (&buffer_cache[ans].buffer_lock);
 }
 
+/* Writes SIZE bytes from BUFFER at OFFSET in sector SEC_NO,
+   which holds file data. */
 void
 buffer_cache_write (disk_sector_t sec_no, void *buffer, off_t size, off_t offset)
 {
-  uint32_t i;
-  int ans = -1;
-  // buffer_cache에 먼저 불러온 것이 있는지 검사
-  // 있으면 걍 그거로부터 읽음
-  for (i = 0; i < BUFFER_CACHE_SIZE; i++)
+  buffer_cache_put (sec_no, buffer, size, offset, false);
+}
+
+/* Writes SIZE bytes from BUFFER at OFFSET in sector SEC_NO,
+   which holds metadata, and keeps the sector from reaching the
+   disk until the journal commits it. */
+void
+buffer_cache_write_meta (disk_sector_t sec_no, const void *buffer, off_t size,
+                         off_t offset)
+{
+  buffer_cache_put (sec_no, buffer, size, offset, true);
+}
+
+static void
+buffer_cache_put (disk_sector_t sec_no, const void *buffer, off_t size,
+                  off_t offset, bool meta)
+{
+  int ans = buffer_cache_get (sec_no, true);
+
+  memcpy ((uint8_t*) &buffer_cache[ans].data + offset, buffer, size);
+  buffer_cache[ans].dirty = true;
+  buffer_cache[ans].meta = meta;
+  lock_release (&buffer_cache[ans].buffer_lock);
+}
+
+/* Copies SIZE bytes at SRC_OFS in sector SRC to DST_OFS in
+   sector DST straight from one cache slot to the other, without
+   an intermediate buffer. */
+void
+buffer_cache_copy (disk_sector_t dst, off_t dst_ofs,
+                   disk_sector_t src, off_t src_ofs, off_t size)
+{
+  int s, d;
+
+  /* Holding SRC's slot while waiting for DST's could deadlock
+     against a copy the other way, so back off and retry
+     instead. */
+  for (;;)
   {
-    if (buffer_cache[i].sector_no == sec_no && buffer_cache[i].allocated)
+    s = buffer_cache_get (src, true);
+    if (dst == src)
     {
-      ans = i;
+      d = s;
       break;
     }
+    d = buffer_cache_get (dst, false);
+    if (d >= 0)
+      break;
+    lock_release (&buffer_cache[s].buffer_lock);
+    thread_yield ();
   }
 
-  if (ans < 0)
+  memmove ((uint8_t*) &buffer_cache[d].data + dst_ofs,
+           (uint8_t*) &buffer_cache[s].data + src_ofs, size);
+  buffer_cache[d].dirty = true;
+  buffer_cache[d].meta = false;
+  if (d != s)
+    lock_release (&buffer_cache[d].buffer_lock);
+  lock_release (&buffer_cache[s].buffer_lock);
+}
+
+void
+buffer_cache_write_back (void)
+{
+  int i;
+  for (i = 0; i < BUFFER_CACHE_SIZE; i++)
   {
-    ans = buffer_cache_find_victim ();
-    lock_acquire (&buffer_cache[ans].buffer_lock);
-    disk_read (filesys_disk, sec_no, &buffer_cache[ans].data);
-    buffer_cache[ans].allocated = true;
-    buffer_cache[ans].accessed = true;
-    buffer_cache[ans].sector_no = sec_no;
-    lock_release (&buffer_cache[ans].buffer_lock);
+    lock_acquire (&buffer_cache[i].buffer_lock);
+    if (buffer_cache[i].allocated && buffer_cache[i].dirty
+        && !buffer_cache[i].meta)
+    {
+      disk_write (filesys_disk, buffer_cache[i].sector_no, &buffer_cache[i].data);
+      buffer_cache[i].dirty = false;
+    }
+    lock_release (&buffer_cache[i].buffer_lock);
   }
+}
 
-  memcpy ((uint8_t*) &buffer_cache[ans].data + offset, buffer, size);
-  buffer_cache[ans].dirty = true;
+/* Returns the number of slots holding uncommitted metadata.  The
+   count is not locked, so it is only a hint. */
+size_t
+buffer_cache_meta_cnt (void)
+{
+  size_t i, cnt = 0;
+
+  for (i = 0; i < BUFFER_CACHE_SIZE; i++)
+    if (buffer_cache[i].allocated && buffer_cache[i].meta)
+      cnt++;
+  return cnt;
+}
+
+/* Writes every slot holding uncommitted metadata to consecutive
+   sectors starting at LOG, up to MAX of them, and stores the
+   sector each belongs in into SECTORS.  Returns the number
+   written.  The slots stay dirty until buffer_cache_checkpoint(). */
+size_t
+buffer_cache_log (disk_sector_t log, disk_sector_t sectors[], size_t max)
+{
+  size_t i, cnt = 0;
+
+  for (i = 0; i < BUFFER_CACHE_SIZE && cnt < max; i++)
+  {
+    lock_acquire (&buffer_cache[i].buffer_lock);
+    if (buffer_cache[i].allocated && buffer_cache[i].meta)
+    {
+      disk_write (filesys_disk, log + cnt, &buffer_cache[i].data);
+      sectors[cnt++] = buffer_cache[i].sector_no;
+    }
+    lock_release (&buffer_cache[i].buffer_lock);
+  }
+  return cnt;
 }
 
+/* Writes every slot holding metadata that buffer_cache_log() put
+   in the log to its own sector, and marks it clean. */
 void
-buffer_cache_write_back (void)
+buffer_cache_checkpoint (void)
 {
   int i;
+
   for (i = 0; i < BUFFER_CACHE_SIZE; i++)
-    if (buffer_cache[i].allocated && buffer_cache[i].dirty)
+  {
+    lock_acquire (&buffer_cache[i].buffer_lock);
+    if (buffer_cache[i].allocated && buffer_cache[i].meta)
     {
-      lock_acquire (&buffer_cache[i].buffer_lock);
       disk_write (filesys_disk, buffer_cache[i].sector_no, &buffer_cache[i].data);
-      lock_release (&buffer_cache[i].buffer_lock);
+      buffer_cache[i].dirty = false;
+      buffer_cache[i].meta = false;
     }
+    lock_release (&buffer_cache[i].buffer_lock);
+  }
 }
 #endif
@@ -11,9 +11,14 @@
 
 void buffer_cache_init (void);
 bool buffer_cache_release (disk_sector_t sec_no);
-uint32_t buffer_cache_find_victim (void);
 void buffer_cache_read (disk_sector_t sec_no, void *buffer, off_t size, off_t offset);
 void buffer_cache_write (disk_sector_t sec_no, void *buffer, off_t size, off_t offset);
+void buffer_cache_write_meta (disk_sector_t sec_no, const void *buffer, off_t size, off_t offset);
+void buffer_cache_copy (disk_sector_t dst, off_t dst_ofs, disk_sector_t src, off_t src_ofs, off_t size);
+void buffer_cache_flush (disk_sector_t sec_no);
 void buffer_cache_write_back (void);
+size_t buffer_cache_meta_cnt (void);
+size_t buffer_cache_log (disk_sector_t log, disk_sector_t sectors[], size_t max);
+void buffer_cache_checkpoint (void);
 #endif
 #endif
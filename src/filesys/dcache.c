@@ -0,0 +1,194 @@
+#include "filesys/dcache.h"
+#ifdef PRJ4
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Name cache.
+
+   Remembers what looking up a name in a directory gave, keyed
+   on the directory's sector and the name, so that resolving a
+   path does not read directory entries for components it has
+   seen recently.  Names that were looked up and not found are
+   remembered too, as DCACHE_NOENT.  The least recently used
+   name is dropped once DCACHE_SIZE names are cached. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in dentries. */
+    struct list_elem lru_elem;          /* Element in lru_list. */
+    disk_sector_t parent;               /* Directory holding the name. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    disk_sector_t sector;               /* Inode sector or DCACHE_NOENT. */
+  };
+
+static struct hash dentries;
+static struct list lru_list;            /* Most recently used first. */
+static struct lock dcache_lock;         /* Guards all of the above. */
+
+/* Bumped by every change to a directory, so that a lookup that
+   raced with one does not cache a stale answer. */
+static unsigned generation;
+
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+  if (a->parent != b->parent)
+    return a->parent < b->parent;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the cached entry for NAME in PARENT, or a null
+   pointer.  dcache_lock must be held. */
+static struct dentry *
+dentry_find (disk_sector_t parent, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  key.parent = parent;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Drops D from the cache.  dcache_lock must be held. */
+static void
+dentry_free (struct dentry *d)
+{
+  hash_delete (&dentries, &d->hash_elem);
+  list_remove (&d->lru_elem);
+  free (d);
+}
+
+/* Records SECTOR for NAME in PARENT, replacing any earlier entry.
+   dcache_lock must be held. */
+static void
+dentry_set (disk_sector_t parent, const char *name, disk_sector_t sector)
+{
+  struct dentry *d = dentry_find (parent, name);
+
+  if (d == NULL)
+    {
+      if (hash_size (&dentries) >= DCACHE_SIZE)
+        dentry_free (list_entry (list_back (&lru_list),
+                                 struct dentry, lru_elem));
+      d = malloc (sizeof *d);
+      if (d == NULL)
+        return;
+      d->parent = parent;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dentries, &d->hash_elem);
+    }
+  else
+    list_remove (&d->lru_elem);
+  d->sector = sector;
+  list_push_front (&lru_list, &d->lru_elem);
+}
+
+/* Initializes the name cache. */
+void
+dcache_init (void)
+{
+  hash_init (&dentries, dentry_hash, dentry_less, NULL);
+  list_init (&lru_list);
+  lock_init (&dcache_lock);
+  generation = 0;
+}
+
+/* Looks up NAME in directory PARENT.  On a hit, stores the inode
+   sector, or DCACHE_NOENT if NAME is known not to exist, into
+   *SECTORP and returns true.  On a miss, stores a generation
+   number into *GENP to be passed to dcache_fill() along with
+   the result of reading the directory, and returns false. */
+bool
+dcache_lookup (disk_sector_t parent, const char *name,
+               disk_sector_t *sectorp, unsigned *genp)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (parent, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&lru_list, &d->lru_elem);
+      *sectorp = d->sector;
+    }
+  else
+    *genp = generation;
+  lock_release (&dcache_lock);
+  return d != NULL;
+}
+
+/* Caches SECTOR, which may be DCACHE_NOENT, as the result of
+   looking up NAME in PARENT after a dcache_lookup() miss that
+   returned GEN.  Does nothing if a directory changed since. */
+void
+dcache_fill (disk_sector_t parent, const char *name, disk_sector_t sector,
+             unsigned gen)
+{
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  if (gen == generation)
+    dentry_set (parent, name, sector);
+  lock_release (&dcache_lock);
+}
+
+/* Notes that NAME was added to PARENT with its inode at
+   SECTOR. */
+void
+dcache_add (disk_sector_t parent, const char *name, disk_sector_t sector)
+{
+  lock_acquire (&dcache_lock);
+  generation++;
+  dentry_set (parent, name, sector);
+  lock_release (&dcache_lock);
+}
+
+/* Notes that NAME was removed from PARENT. */
+void
+dcache_remove (disk_sector_t parent, const char *name)
+{
+  lock_acquire (&dcache_lock);
+  generation++;
+  dentry_set (parent, name, DCACHE_NOENT);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets every name in directory PARENT, which is being
+   removed.  Its sector may later hold a different directory. */
+void
+dcache_purge (disk_sector_t parent)
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dcache_lock);
+  generation++;
+  for (e = list_begin (&lru_list); e != list_end (&lru_list); e = next)
+    {
+      struct dentry *d = list_entry (e, struct dentry, lru_elem);
+      next = list_next (e);
+      if (d->parent == parent)
+        dentry_free (d);
+    }
+  lock_release (&dcache_lock);
+}
+#endif
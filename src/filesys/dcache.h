@@ -0,0 +1,22 @@
+#ifndef __FILESYS_DCACHE_H
+#define __FILESYS_DCACHE_H
+#ifdef PRJ4
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Number of names kept in the cache. */
+#define DCACHE_SIZE 128
+
+/* Sector recorded for a name known not to exist. */
+#define DCACHE_NOENT ((disk_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (disk_sector_t parent, const char *name,
+                    disk_sector_t *sectorp, unsigned *genp);
+void dcache_fill (disk_sector_t parent, const char *name,
+                  disk_sector_t sector, unsigned gen);
+void dcache_add (disk_sector_t parent, const char *name, disk_sector_t sector);
+void dcache_remove (disk_sector_t parent, const char *name);
+void dcache_purge (disk_sector_t parent);
+#endif
+#endif
@@ -1,9 +1,14 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/super.h"
 #include "threads/malloc.h"
 
 /* A directory. */
@@ -19,9 +24,157 @@ struct dir_entry
     disk_sector_t inode_sector;         /* Sector number of header. */
     char name[NAME_MAX + 1];            /* Null terminated file name. */
     bool in_use;                        /* In use or free? */
-    uint32_t level;
+    bool is_dir;                        /* Names a directory? */
+    disk_sector_t index;                /* In ".": sector of hash index. */
   };
 
+#ifdef PRJ4
+/* Compact directories.
+
+   A compact directory holds variable-length records, as in
+   ext2, instead of fixed-size dir_entry slots.  A record takes
+   only as many bytes as its name needs, so a sector holds about
+   twice as many names and scans read fewer sectors.  REC_LEN
+   gives the distance to the next record.  Records never cross a
+   sector boundary and the last one in a sector runs to its end,
+   so every sector starts with a record.  dir_add() puts new
+   entries in the slack after a record's name, or appends a
+   sector if there is none, and dir_remove() merges a record into
+   the one before it in its sector, or marks it free if it is the
+   first, so freed space coalesces.  The "." record always comes
+   first and keeps the index sector right after its name.
+
+   do_format() makes the root directory compact unless the
+   kernel is given -fixed-dirs, and every other directory takes
+   after its parent. */
+struct dir_record
+  {
+    disk_sector_t inode_sector;         /* Sector number of header, 0 if free. */
+    uint16_t rec_len;                   /* Bytes from here to next record. */
+    uint8_t name_len;                   /* Length of name that follows. */
+    bool is_dir;                        /* Names a directory? */
+  };
+
+/* Bytes taken by a record with a NAME_LEN-byte name. */
+#define REC_SIZE(NAME_LEN) \
+        ROUND_UP (sizeof (struct dir_record) + (NAME_LEN), 4)
+
+/* Offset of the index sector in the "." record. */
+#define DOT_INDEX_OFS REC_SIZE (1)
+
+/* Create fixed-format directories, from the -fixed-dirs option. */
+bool dir_fixed_format;
+
+static bool is_compact (struct inode *);
+static bool record_read (struct inode *, off_t *, struct dir_entry *);
+static off_t record_add (struct inode *, off_t, const struct dir_entry *);
+static bool record_erase (struct inode *, off_t);
+
+/* Hashed index.
+
+   Once a directory grows past the size of DIR_INDEX_MIN
+   fixed-size entries it gets an index: a separate file holding
+   an open-addressed hash table that maps names to entry
+   offsets, so that lookups no longer read every entry and adds
+   no longer scan for room.  The index's sector is kept in the
+   "." entry, which always comes first in a directory.  The index
+   only speeds up access to the entries, which stay where they
+   are, so a directory without one is simply scanned. */
+#define DIR_INDEX_MIN 32
+
+/* Header at the start of an index file, followed by SLOT_CNT
+   slots.  A slot holds INDEX_EMPTY, INDEX_DELETED, or an entry's
+   byte offset plus 1. */
+struct dir_index
+  {
+    uint32_t slot_cnt;                  /* Number of slots, a power of 2. */
+    uint32_t used_cnt;                  /* Slots that are not empty. */
+    uint32_t free_hint;                 /* No room worth a look before here. */
+  };
+
+#define INDEX_EMPTY 0
+#define INDEX_DELETED 0xffffffff
+#define SLOT_OFS(SLOT) ((off_t) (sizeof (struct dir_index) \
+                                 + (SLOT) * sizeof (uint32_t)))
+
+static struct inode *index_open (struct inode *);
+static void index_build (struct inode *);
+static void index_destroy (struct inode *);
+static bool index_lookup (struct inode *, struct inode *, const char *,
+                          struct dir_entry *, off_t *);
+static bool index_insert (struct inode *, struct dir_index *, const char *,
+                          off_t);
+static void index_delete (struct inode *, struct inode *, const char *,
+                          off_t);
+#endif
+
+/* Reads the entry at *POSP in directory INODE into *E, free or
+   not, and advances *POSP past it.  Returns false at end of
+   directory. */
+static bool
+read_entry (struct inode *inode, off_t *posp, struct dir_entry *e)
+{
+#ifdef PRJ4
+  if (is_compact (inode))
+    return record_read (inode, posp, e);
+#endif
+  if (inode_read_at (inode, e, sizeof *e, *posp) != sizeof *e)
+    return false;
+  *posp += sizeof *e;
+  return true;
+}
+
+/* Writes E into directory INODE, looking for room from offset
+   START on.  Returns the entry's offset, or -1 on failure. */
+static off_t
+add_entry (struct inode *inode, off_t start, const struct dir_entry *e)
+{
+  struct dir_entry cur;
+  off_t ofs;
+
+#ifdef PRJ4
+  if (is_compact (inode))
+    return record_add (inode, start, e);
+#endif
+
+  /* Set OFS to offset of free slot.
+     If there are no free slots, then it will be set to the
+     current end-of-file.
+     
+     inode_read_at() will only return a short read at end of file.
+     Otherwise, we'd need to verify that we didn't get a short
+     read due to something intermittent such as low memory. */
+  for (ofs = start; inode_read_at (inode, &cur, sizeof cur, ofs) == sizeof cur;
+       ofs += sizeof cur)
+    if (!cur.in_use)
+      break;
+  return inode_write_at (inode, e, sizeof *e, ofs) == sizeof *e ? ofs : -1;
+}
+
+/* Erases E, the entry at OFS in directory INODE.  Returns true
+   if successful, false on failure. */
+static bool
+erase_entry (struct inode *inode, off_t ofs, struct dir_entry *e)
+{
+#ifdef PRJ4
+  if (is_compact (inode))
+    return record_erase (inode, ofs);
+#endif
+  e->in_use = false;
+  return inode_write_at (inode, e, sizeof *e, ofs) == sizeof *e;
+}
+
+/* Returns true if E is an entry that dir_readdir() reports. */
+static bool
+is_listed (const struct dir_entry *e)
+{
+#ifdef PRJ4
+  if (!strcmp (e->name, ".") || !strcmp (e->name, ".."))
+    return false;
+#endif
+  return e->in_use;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -29,18 +182,29 @@ bool
 dir_create (disk_sector_t sector, disk_sector_t parent, size_t entry_cnt) 
 {
   uint32_t new_level;
+  bool compact;
   if (sector != ROOT_DIR_SECTOR)
   {
     struct inode *parent_inode = inode_open (parent);
     new_level = inode_get_level (parent_inode) + 1;
+    compact = is_compact (parent_inode);
     inode_close (parent_inode);
     if (new_level > 213)
       return false;
   }
-  else new_level = 0;
+  else
+  {
+    new_level = 0;
+    compact = !dir_fixed_format;
+  }
 
+  /* A compact directory grows a sector at a time as it needs
+     room, so it starts out empty. */
   uint32_t new_info = inode_set_level (1, new_level);
-  if (!inode_create (sector, entry_cnt * sizeof (struct dir_entry), new_info))
+  if (compact)
+    new_info |= INODE_DIR_COMPACT;
+  if (!inode_create (sector, compact ? 0 : entry_cnt * sizeof (struct dir_entry),
+                     new_info))
     return false;
 
   struct dir *d = dir_open (inode_open (sector));
@@ -68,11 +232,7 @@ dir_open (struct inode *inode)
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
-#ifdef PRJ4
-      dir->pos = 2 * sizeof (struct dir_entry);
-#else
       dir->pos = 0;
-#endif
       return dir;
     }
   else
@@ -127,21 +287,42 @@ lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
   struct dir_entry e;
-  size_t ofs;
+  off_t pos, ofs;
+#ifdef PRJ4
+  struct inode *index;
+#endif
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
+#ifdef PRJ4
+  /* A hit in the index is always right, but a miss is not
+     trusted: the index may have fallen behind the directory,
+     for example when it could not be grown, so the scan below
+     has the last word. */
+  index = index_open (dir->inode);
+  if (index != NULL)
+    {
+      bool found = index_lookup (index, dir->inode, name, ep, ofsp);
+      inode_close (index);
+      if (found)
         return true;
-      }
+    }
+#endif
+
+  ofs = pos = 0;
+  while (read_entry (dir->inode, &pos, &e))
+    {
+      if (e.in_use && !strcmp (name, e.name)) 
+        {
+          if (ep != NULL)
+            *ep = e;
+          if (ofsp != NULL)
+            *ofsp = ofs;
+          return true;
+        }
+      ofs = pos;
+    }
   return false;
 }
 
@@ -154,14 +335,40 @@ dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
   struct dir_entry e;
+#ifdef PRJ4
+  disk_sector_t parent, sector;
+  unsigned gen;
+#endif
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+#ifdef PRJ4
+  parent = inode_get_inumber (dir->inode);
+  /* Hold the directory lock even on a hit, so that dir_remove()
+     cannot free the entry's inode before we open it. */
+  inode_lock_dir (dir->inode, false);
+  if (dcache_lookup (parent, name, &sector, &gen))
+    *inode = sector != DCACHE_NOENT ? inode_open (sector) : NULL;
+  else if (lookup (dir, name, &e, NULL))
+    {
+      dcache_fill (parent, name, e.inode_sector, gen);
+      *inode = inode_open (e.inode_sector);
+    }
+  else
+    {
+      dcache_fill (parent, name, DCACHE_NOENT, gen);
+      *inode = NULL;
+    }
+  inode_unlock_dir (dir->inode, false);
+#else
+  inode_lock_dir (dir->inode, false);
   if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
+  inode_unlock_dir (dir->inode, false);
+#endif
 
   return *inode != NULL;
 }
@@ -170,14 +377,18 @@ dir_lookup (const struct dir *dir, const char *name,
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long), DIR has been removed,
+   or a disk or memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) 
 {
   struct dir_entry e;
-  off_t ofs;
+  off_t ofs = 0;
   bool success = false;
+#ifdef PRJ4
+  struct inode *index = NULL;
+  struct dir_index h;
+#endif
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
@@ -186,29 +397,71 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  /* Nothing may be added to a directory once it is removed,
+     which dir_remove() checks for under the same lock. */
+  inode_lock_dir (dir->inode, true);
+  if (inode_is_removed (dir->inode))
+    goto done;
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e)
-    if (!e.in_use)
-      break;
+  /* Start looking for room where the index says there may be
+     some. */
+#ifdef PRJ4
+  index = index_open (dir->inode);
+  if (index != NULL
+      && inode_read_at (index, &h, sizeof h, 0) == sizeof h)
+    ofs = h.free_hint;
+#endif
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  e.index = 0;
+#ifdef PRJ4
+  {
+    struct inode *inode = inode_open (inode_sector);
+    e.is_dir = inode != NULL && inode_is_directory (inode);
+    inode_close (inode);
+  }
+#endif
+  ofs = add_entry (dir->inode, ofs, &e);
+  success = ofs >= 0;
+#ifdef PRJ4
+  if (success)
+    dcache_add (inode_get_inumber (dir->inode), name, inode_sector);
+#endif
+
+#ifdef PRJ4
+  if (success && index != NULL)
+    {
+      /* An index missing an entry would hide it, so fall back to
+         scanning if the entry cannot be added. */
+      if (!index_insert (index, &h, name, ofs))
+        index_destroy (dir->inode);
+      else
+        {
+          h.free_hint = (is_compact (dir->inode)
+                         ? ROUND_DOWN (ofs, DISK_SECTOR_SIZE)
+                         : ofs + (off_t) sizeof e);
+          inode_write_at (index, &h, sizeof h, 0);
+          if (h.used_cnt * 2 > h.slot_cnt)
+            index_build (dir->inode);
+        }
+    }
+  else if (success
+           && inode_length (dir->inode) >= DIR_INDEX_MIN * (off_t) sizeof e)
+    index_build (dir->inode);
+#endif
 
  done:
+#ifdef PRJ4
+  inode_close (index);
+#endif
+  inode_unlock_dir (dir->inode, true);
   return success;
 }
 
@@ -222,10 +475,16 @@ dir_remove (struct dir *dir, const char *name)
   struct inode *inode = NULL;
   bool success = false;
   off_t ofs;
+#ifdef PRJ4
+  struct inode *index;
+  bool is_dir = false;
+#endif
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_lock_dir (dir->inode, true);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -239,20 +498,49 @@ dir_remove (struct dir *dir, const char *name)
   if (inode_get_inumber (inode) == thread_current ()->current_dir)
     goto done;
 
-  if (inode_is_directory (inode) && !dir_is_empty (inode))
-    goto done;
+  /* Hold a directory's own lock until it is marked removed, so
+     that nothing is added to it after it is found empty. */
+  is_dir = inode_is_directory (inode);
+  if (is_dir)
+    {
+      inode_lock_dir (inode, true);
+      if (!dir_is_empty (inode))
+        goto done;
+    }
 #endif
 
   /* Erase directory entry. */
-  e.in_use = false;
-  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
+  if (!erase_entry (dir->inode, ofs, &e))
     goto done;
 
+#ifdef PRJ4
+  /* Drop it from the index and the name cache.  A removed
+     directory, which is empty by now, loses its index and any
+     cached names too. */
+  index = index_open (dir->inode);
+  if (index != NULL)
+    {
+      index_delete (index, dir->inode, name, ofs);
+      inode_close (index);
+    }
+  dcache_remove (inode_get_inumber (dir->inode), name);
+  if (is_dir)
+    {
+      index_destroy (inode);
+      dcache_purge (inode_get_inumber (inode));
+    }
+#endif
+
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+#ifdef PRJ4
+  if (is_dir)
+    inode_unlock_dir (inode, true);
+#endif
+  inode_unlock_dir (dir->inode, true);
   inode_close (inode);
   return success;
 }
@@ -264,33 +552,83 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_lock_dir (dir->inode, false);
+  while (read_entry (dir->inode, &dir->pos, &e))
+    if (is_listed (&e))
+      {
+        strlcpy (name, e.name, NAME_MAX + 1);
+        found = true;
+        break;
+      } 
+  inode_unlock_dir (dir->inode, false);
+  return found;
+}
+
+#ifdef PRJ4
+/* Number of entries dir_getdents() reads at a time. */
+#define GETDENTS_BATCH 16
+
+/* Copies directory entry E into *D. */
+static void
+set_dirent (struct dirent *d, const struct dir_entry *e)
+{
+  d->inumber = e->inode_sector;
+  d->isdir = e->is_dir;
+  strlcpy (d->name, e->name, sizeof d->name);
+}
+
+/* Reads up to CNT of the next entries in DIR into ENTS and
+   returns the number read, which is 0 once the directory
+   contains no more entries.  Reads a fixed-format directory
+   several entries at a time rather than one by one like
+   dir_readdir(). */
+size_t
+dir_getdents (struct dir *dir, struct dirent *ents, size_t cnt)
+{
+  struct dir_entry batch[GETDENTS_BATCH];
+  size_t n = 0;
+
+  inode_lock_dir (dir->inode, false);
+  if (is_compact (dir->inode))
     {
-      dir->pos += sizeof e;
-      if (e.in_use)
+      while (n < cnt && read_entry (dir->inode, &dir->pos, batch))
+        if (is_listed (batch))
+          set_dirent (&ents[n++], batch);
+      inode_unlock_dir (dir->inode, false);
+      return n;
+    }
+
+  while (n < cnt)
+    {
+      off_t bytes = inode_read_at (dir->inode, batch, sizeof batch, dir->pos);
+      size_t got = bytes / sizeof *batch;
+      size_t i;
+
+      if (got == 0)
+        break;
+      for (i = 0; i < got && n < cnt; i++)
         {
-          strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
-        } 
+          dir->pos += sizeof *batch;
+          if (is_listed (&batch[i]))
+            set_dirent (&ents[n++], &batch[i]);
+        }
     }
-  return false;
+  inode_unlock_dir (dir->inode, false);
+  return n;
 }
 
-#ifdef PRJ4
 /* return true if dir is empty except . and .. */
 bool
 dir_is_empty (struct inode *inode)
 {
   struct dir_entry e;
-  off_t pos = 2 * sizeof (struct dir_entry);
+  off_t pos = 0;
 
-  while (inode_read_at (inode, &e, sizeof e, pos) == sizeof e) 
-    {
-      pos += sizeof e;
-      if (e.in_use)
-          return false;
-    }
+  while (read_entry (inode, &pos, &e))
+    if (is_listed (&e))
+      return false;
   return true;
 }
 
@@ -300,13 +638,366 @@ print_all_directory (struct inode *inode)
   off_t pos = 0;
   struct dir_entry e;
 
-  while (inode_read_at (inode, &e, sizeof e, pos) == sizeof e) 
+  while (read_entry (inode, &pos, &e))
     {
-      pos += sizeof e;
       if (e.in_use)
       printf ("directory sector : %d, pos : %d, in_use : %d, name : %s\n",\
           inode_get_inumber (inode), pos, e.in_use, e.name);
     }
 }
-#endif
 
+/* Returns true if directory INODE holds compact records. */
+static bool
+is_compact (struct inode *inode)
+{
+  return (inode_get_info (inode) & INODE_DIR_COMPACT) != 0;
+}
+
+/* Returns the bytes a record at OFS with a NAME_LEN-byte name
+   needs, counting the index sector kept by the "." record. */
+static size_t
+record_size (size_t name_len, off_t ofs)
+{
+  return REC_SIZE (name_len) + (ofs == 0 ? sizeof (disk_sector_t) : 0);
+}
+
+/* Reads the record header at OFS in INODE into *R.  Returns
+   false at end of directory or if the header is bad. */
+static bool
+record_header (struct inode *inode, off_t ofs, struct dir_record *r)
+{
+  return (inode_read_at (inode, r, sizeof *r, ofs) == sizeof *r
+          && r->rec_len >= sizeof *r
+          && r->rec_len <= DISK_SECTOR_SIZE - ofs % DISK_SECTOR_SIZE);
+}
+
+/* Reads the record at *POSP in INODE into *E, as read_entry()
+   does. */
+static bool
+record_read (struct inode *inode, off_t *posp, struct dir_entry *e)
+{
+  uint8_t buf[sizeof (struct dir_record) + NAME_MAX];
+  struct dir_record *r = (struct dir_record *) buf;
+  off_t room = DISK_SECTOR_SIZE - *posp % DISK_SECTOR_SIZE;
+  off_t got = inode_read_at (inode, buf,
+                             room < (off_t) sizeof buf ? room : (off_t) sizeof buf,
+                             *posp);
+  size_t len;
+
+  if (got < (off_t) sizeof *r || r->rec_len < sizeof *r
+      || r->rec_len > room)
+    return false;
+  len = r->name_len;
+  if (len > got - sizeof *r)
+    len = got - sizeof *r;
+
+  e->inode_sector = r->inode_sector;
+  e->in_use = r->inode_sector != 0;
+  e->is_dir = r->is_dir;
+  memcpy (e->name, r + 1, len);
+  e->name[len] = '\0';
+  e->index = 0;
+  *posp += r->rec_len;
+  return true;
+}
+
+/* Fills BUF with a REC_LEN-byte record for E at offset OFS and
+   returns the number of bytes that need writing. */
+static size_t
+record_fill (void *buf, off_t ofs, size_t rec_len, const struct dir_entry *e)
+{
+  struct dir_record *r = buf;
+  size_t len = strlen (e->name);
+  size_t size = record_size (len, ofs);
+
+  memset (buf, 0, size);
+  r->inode_sector = e->inode_sector;
+  r->rec_len = rec_len;
+  r->name_len = len;
+  r->is_dir = e->is_dir;
+  memcpy (r + 1, e->name, len);
+  return size;
+}
+
+/* Writes E into compact directory INODE, as add_entry() does.
+   Takes the first record from START on with enough slack after
+   its name, or else appends a sector. */
+static off_t
+record_add (struct inode *inode, off_t start, const struct dir_entry *e)
+{
+  uint8_t buf[REC_SIZE (NAME_MAX) + sizeof (disk_sector_t)];
+  size_t len = strlen (e->name);
+  struct dir_record r;
+  uint8_t *sector;
+  off_t pos, ofs;
+  size_t size;
+
+  for (pos = start; record_header (inode, pos, &r); pos += r.rec_len)
+    {
+      size_t used = r.inode_sector != 0 ? record_size (r.name_len, pos) : 0;
+
+      ofs = pos + used;
+      if (r.rec_len - used < record_size (len, ofs))
+        continue;
+
+      /* Write the new record into the slack first, so that it
+         only shows up once the record before it is shortened. */
+      size = record_fill (buf, ofs, r.rec_len - used, e);
+      if (inode_write_at (inode, buf, size, ofs) != (off_t) size)
+        return -1;
+      if (used > 0)
+        {
+          r.rec_len = used;
+          if (inode_write_at (inode, &r, sizeof r, pos) != sizeof r)
+            return -1;
+        }
+      return ofs;
+    }
+
+  /* No room: append a sector holding just this record. */
+  sector = calloc (1, DISK_SECTOR_SIZE);
+  if (sector == NULL)
+    return -1;
+  ofs = ROUND_UP (inode_length (inode), DISK_SECTOR_SIZE);
+  record_fill (sector, ofs, DISK_SECTOR_SIZE, e);
+  if (inode_write_at (inode, sector, DISK_SECTOR_SIZE, ofs) != DISK_SECTOR_SIZE)
+    ofs = -1;
+  free (sector);
+  return ofs;
+}
+
+/* Erases the record at OFS in compact directory INODE, giving
+   its space to the record before it in the same sector.  Returns
+   true if successful, false on failure. */
+static bool
+record_erase (struct inode *inode, off_t ofs)
+{
+  off_t pos = ROUND_DOWN (ofs, DISK_SECTOR_SIZE);
+  struct dir_record r, prev;
+
+  if (!record_header (inode, ofs, &r))
+    return false;
+  if (ofs == pos)
+    {
+      /* First in its sector: there is nothing to merge into. */
+      r.inode_sector = 0;
+      return inode_write_at (inode, &r, sizeof r, ofs) == sizeof r;
+    }
+
+  for (; pos < ofs && record_header (inode, pos, &prev); pos += prev.rec_len)
+    if (pos + prev.rec_len == ofs)
+      {
+        prev.rec_len += r.rec_len;
+        return inode_write_at (inode, &prev, sizeof prev, pos) == sizeof prev;
+      }
+  return false;
+}
+
+/* Returns the offset of the index sector in directory
+   DIR_INODE's "." entry. */
+static off_t
+index_field (struct inode *dir_inode)
+{
+  return (is_compact (dir_inode)
+          ? DOT_INDEX_OFS
+          : (off_t) offsetof (struct dir_entry, index));
+}
+
+/* Opens the index of directory DIR_INODE.  Returns a null
+   pointer if the directory has none. */
+static struct inode *
+index_open (struct inode *dir_inode)
+{
+  disk_sector_t sector;
+
+  if (inode_read_at (dir_inode, &sector, sizeof sector,
+                     index_field (dir_inode)) != sizeof sector
+      || sector == 0)
+    return NULL;
+  return inode_open (sector);
+}
+
+/* Records SECTOR as the index of directory DIR_INODE. */
+static void
+index_set_sector (struct inode *dir_inode, disk_sector_t sector)
+{
+  inode_write_at (dir_inode, &sector, sizeof sector, index_field (dir_inode));
+}
+
+/* Searches INDEX, the index of DIR_INODE, for NAME, and behaves
+   as lookup() does. */
+static bool
+index_lookup (struct inode *index, struct inode *dir_inode, const char *name,
+              struct dir_entry *ep, off_t *ofsp)
+{
+  struct dir_index h;
+  struct dir_entry e;
+  uint32_t slot, value, probes;
+  off_t pos;
+
+  if (inode_read_at (index, &h, sizeof h, 0) != sizeof h)
+    return false;
+  slot = hash_string (name) & (h.slot_cnt - 1);
+  for (probes = 0; probes < h.slot_cnt; probes++)
+    {
+      if (inode_read_at (index, &value, sizeof value, SLOT_OFS (slot))
+          != sizeof value || value == INDEX_EMPTY)
+        break;
+      pos = value - 1;
+      if (value != INDEX_DELETED
+          && read_entry (dir_inode, &pos, &e)
+          && e.in_use && !strcmp (name, e.name))
+        {
+          if (ep != NULL)
+            *ep = e;
+          if (ofsp != NULL)
+            *ofsp = value - 1;
+          return true;
+        }
+      slot = (slot + 1) & (h.slot_cnt - 1);
+    }
+  return false;
+}
+
+/* Adds the entry at offset OFS, named NAME, to INDEX, whose
+   header is H.  Updates H, but leaves writing it back to the
+   caller.  Returns false if INDEX is full or cannot be read. */
+static bool
+index_insert (struct inode *index, struct dir_index *h, const char *name,
+              off_t ofs)
+{
+  uint32_t slot = hash_string (name) & (h->slot_cnt - 1);
+  uint32_t value, probes;
+
+  for (probes = 0; probes < h->slot_cnt; probes++)
+    {
+      if (inode_read_at (index, &value, sizeof value, SLOT_OFS (slot))
+          != sizeof value)
+        return false;
+      if (value == INDEX_EMPTY || value == INDEX_DELETED)
+        break;
+      slot = (slot + 1) & (h->slot_cnt - 1);
+    }
+  if (probes == h->slot_cnt)
+    return false;
+  if (value == INDEX_EMPTY)
+    h->used_cnt++;
+  value = ofs + 1;
+  return inode_write_at (index, &value, sizeof value, SLOT_OFS (slot))
+         == sizeof value;
+}
+
+/* Removes the entry at offset OFS in DIR_INODE, named NAME,
+   from INDEX, the directory's index. */
+static void
+index_delete (struct inode *index, struct inode *dir_inode, const char *name,
+              off_t ofs)
+{
+  struct dir_index h;
+  uint32_t slot, value, probes;
+  off_t hint;
+
+  if (inode_read_at (index, &h, sizeof h, 0) != sizeof h)
+    return;
+  slot = hash_string (name) & (h.slot_cnt - 1);
+  for (probes = 0; probes < h.slot_cnt; probes++)
+    {
+      if (inode_read_at (index, &value, sizeof value, SLOT_OFS (slot))
+          != sizeof value || value == INDEX_EMPTY)
+        return;
+      if (value == (uint32_t) ofs + 1)
+        {
+          value = INDEX_DELETED;
+          inode_write_at (index, &value, sizeof value, SLOT_OFS (slot));
+          break;
+        }
+      slot = (slot + 1) & (h.slot_cnt - 1);
+    }
+
+  /* A removed record leaves room in its sector. */
+  hint = is_compact (dir_inode) ? ROUND_DOWN (ofs, DISK_SECTOR_SIZE) : ofs;
+  if ((uint32_t) hint < h.free_hint)
+    {
+      h.free_hint = hint;
+      inode_write_at (index, &h, sizeof h, 0);
+    }
+}
+
+/* Builds a fresh index for DIR_INODE with room to grow, and
+   replaces the old one, if any.  Rebuilding also clears out
+   deleted slots.  Leaves the old index in place if there is no
+   room for a new one. */
+static void
+index_build (struct inode *dir_inode)
+{
+  struct dir_index h;
+  struct dir_entry e;
+  struct inode *index;
+  disk_sector_t sector;
+  uint32_t entry_cnt = 0;
+  off_t pos, ofs;
+
+  for (pos = 0; read_entry (dir_inode, &pos, &e); )
+    entry_cnt++;
+
+  h.slot_cnt = 16;
+  while (h.slot_cnt < entry_cnt * 4)
+    h.slot_cnt *= 2;
+  h.used_cnt = 0;
+
+  /* Slack in compact records is not worth tracking here, so
+     adds will start over from the beginning. */
+  h.free_hint = is_compact (dir_inode) ? 0 : inode_length (dir_inode);
+
+  if (!free_map_allocate (1, &sector))
+    return;
+  if (!inode_create (sector, SLOT_OFS (h.slot_cnt), INODE_DIR_INDEX))
+    {
+      free_map_release (sector, 1);
+      return;
+    }
+  index = inode_open (sector);
+  if (index == NULL)
+    {
+      release_inode_disk (DIV_ROUND_UP (SLOT_OFS (h.slot_cnt),
+                                        DISK_SECTOR_SIZE), sector);
+      free_map_release (sector, 1);
+      super_add_inodes (-1);
+      return;
+    }
+
+  for (ofs = pos = 0; read_entry (dir_inode, &pos, &e); ofs = pos)
+    {
+      if (e.in_use)
+        {
+          if (!index_insert (index, &h, e.name, ofs))
+            {
+              inode_remove (index);
+              inode_close (index);
+              return;
+            }
+        }
+      else if ((uint32_t) ofs < h.free_hint)
+        h.free_hint = ofs;
+    }
+  inode_write_at (index, &h, sizeof h, 0);
+  inode_close (index);
+
+  index_destroy (dir_inode);
+  index_set_sector (dir_inode, sector);
+}
+
+/* Frees the index of DIR_INODE, if it has one. */
+static void
+index_destroy (struct inode *dir_inode)
+{
+  struct inode *index = index_open (dir_inode);
+
+  if (index != NULL)
+    {
+      inode_remove (index);
+      inode_close (index);
+      index_set_sector (dir_inode, 0);
+    }
+}
+#endif
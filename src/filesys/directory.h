@@ -13,6 +13,22 @@
 
 struct inode;
 
+#ifdef PRJ4
+/* Directory entry as written to user programs by getdents().
+   Must match struct dirent in lib/user/syscall.h. */
+struct dirent
+  {
+    int inumber;                        /* Inode number. */
+    bool isdir;                         /* Directory or ordinary file? */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+  };
+#endif
+
+#ifdef PRJ4
+/* Create fixed-format rather than compact directories. */
+extern bool dir_fixed_format;
+#endif
+
 /* Opening and closing directories. */
 #ifdef PRJ4
 bool dir_create (disk_sector_t sector, disk_sector_t parent, size_t entry_cnt);
@@ -32,5 +48,8 @@ bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, disk_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+#ifdef PRJ4
+size_t dir_getdents (struct dir *, struct dirent *, size_t cnt);
+#endif
 
 #endif /* filesys/directory.h */
@@ -1,6 +1,9 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#ifdef PRJ4
+#include "filesys/journal.h"
+#endif
 #include "threads/malloc.h"
 
 /* An open file. */
@@ -109,6 +112,47 @@ file_write (struct file *file, const void *buffer, off_t size)
   return bytes_written;
 }
 
+#ifdef PRJ4
+/* Copies up to SIZE bytes from SRC to DST, starting at each
+   file's current position, without going through a caller's
+   buffer.  Returns the number of bytes copied, which may be less
+   than SIZE if SRC ends first, or -1 on failure.  Advances both
+   positions by the number of bytes copied. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  struct file *first = dst < src ? dst : src;
+  struct file *second = dst < src ? src : dst;
+  off_t bytes_copied;
+
+  if (inode_is_directory (dst->inode) || inode_is_directory (src->inode))
+    return -1;
+  lock_acquire (&first->pos_lock);
+  if (second != first)
+    lock_acquire (&second->pos_lock);
+  bytes_copied = inode_copy (dst->inode, dst->pos, src->inode, src->pos, size);
+  if (bytes_copied > 0)
+    {
+      src->pos += bytes_copied;
+      if (dst != src)
+        dst->pos += bytes_copied;
+    }
+  if (second != first)
+    lock_release (&second->pos_lock);
+  lock_release (&first->pos_lock);
+  return bytes_copied;
+}
+
+/* Writes FILE's data back to disk and commits the metadata
+   journal, which holds its inode. */
+void
+file_sync (struct file *file)
+{
+  inode_sync (file->inode);
+  journal_commit ();
+}
+#endif
+
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
@@ -120,6 +164,10 @@ off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
+#ifdef PRJ4
+  if (inode_is_directory (file->inode))
+    return -1;
+#endif
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
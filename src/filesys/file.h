@@ -17,6 +17,10 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+#ifdef PRJ4
+off_t file_copy (struct file *dst, struct file *src, off_t size);
+void file_sync (struct file *);
+#endif
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
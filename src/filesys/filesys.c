@@ -6,14 +6,19 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/dcache.h"
+#include "filesys/journal.h"
+#include "filesys/super.h"
 #include "devices/disk.h"
-#include "threads/palloc.h"
-#include "threads/vaddr.h"
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
 
 static void do_format (void);
+#ifdef PRJ4
+static bool resolve (const char *name, struct dir **dirp,
+                     char leaf[NAME_MAX + 1], struct inode **inodep);
+#endif
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -25,7 +30,14 @@ filesys_init (bool format)
     PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
   inode_init ();
+#ifdef PRJ4
+  dcache_init ();
+#endif
   free_map_init ();
+#ifdef PRJ4
+  journal_init (format);
+  super_init (format);
+#endif
 
   if (format) 
     do_format ();
@@ -39,7 +51,8 @@ void
 filesys_done (void) 
 {
 #ifdef PRJ4
-  buffer_cache_write_back ();
+  super_done ();
+  journal_done ();
 #endif
   free_map_close ();
 }
@@ -55,88 +68,39 @@ filesys_create (const char *name, off_t initial_size)
   struct dir *dir;
   bool success;
 #ifdef PRJ4
-  char *ret_ptr, *next_ptr;
+  char leaf[NAME_MAX + 1];
   struct inode *inode;
-  struct thread *tcurrent = thread_current ();
-
-  ret_ptr = palloc_get_page (PAL_ZERO);
-  char** ptpt = malloc (sizeof (char**));
-  memcpy (ptpt, &ret_ptr, sizeof (char**));
-  if (!ret_ptr) return false;
-  strlcpy (ret_ptr, name, PGSIZE);
 
-  if (name[0] == '/') // absolute path
-    dir = dir_open_root ();
-  else // relative path
-    dir = dir_open (inode_open (tcurrent->current_dir));
-  if (dir == NULL)
-  {
-    palloc_free_page (ret_ptr);
+  if (!resolve (name, &dir, leaf, &inode))
     return false;
-  }
   success = false;
-
-  for (ret_ptr = strtok_r (ret_ptr , "/", &next_ptr);
-      ret_ptr != NULL;
-      ret_ptr = strtok_r (NULL, "/", &next_ptr))
+  journal_begin ();
+  if (leaf[0] == '\0' || inode != NULL)
   {
-    if (next_ptr[0] != '\0')
-    {
-      if (!dir_lookup (dir, ret_ptr, &inode))
-      {
-        /* 중간인데 못찾으면 false return */
-        success = false;
-        break;
-      }
-      dir_close (dir);
-      dir = dir_open (inode);
-      if (!dir) 
-        goto done1;
-    }
-    if (next_ptr[0] == '\0')
-    {
-      if (dir_lookup (dir, ret_ptr, &inode))
-      {
-        /* 마지막인데 이미 존재한 경우 return false */
-        success = false;
-        break;
-      }
-      else
-      {
-        success = true;
-        break;
-      }
-    }
-  }
-  if (!success)
-  {
-    dir_close (dir);
-    palloc_free_page (*ptpt);
-    free (ptpt);
-    return false;
+    /* 마지막인데 이미 존재한 경우 return false */
+    inode_close (inode);
+    goto done;
   }
-  success = false;
-  if (dir == NULL) goto done1;
-  if (inode_get_level (dir_get_inode (dir)) > 212) goto done1;
-  if (!free_map_allocate (1, &inode_sector)) goto done1;
+  if (inode_get_level (dir_get_inode (dir)) > 212) goto done;
+  if (!free_map_allocate (1, &inode_sector)) goto done;
   if (!inode_create (inode_sector, initial_size, 0))
   {
     free_map_release (inode_sector, 1);
-    goto done1;
+    goto done;
   }
-  if (!dir_add (dir, ret_ptr, inode_sector))
+  if (!dir_add (dir, leaf, inode_sector))
   {
-    release_inode_disk (DIV_ROUND_UP (initial_size, DISK_SECTOR_SIZE), inode_sector);
-    free_map_release (inode_sector, 1);
-    goto done1;
+    /* Removing the last opener frees the new file. */
+    inode = inode_open (inode_sector);
+    inode_remove (inode);
+    inode_close (inode);
+    goto done;
   }
   success = true;
 
-done1:
-  buffer_cache_write_back ();
+done:
+  journal_end ();
   dir_close (dir);
-  palloc_free_page (*ptpt);
-  free (ptpt);
 #else
   dir = dir_open_root ();
   success = (dir != NULL
@@ -163,57 +127,11 @@ filesys_open (const char *name)
   struct dir *dir;
   struct inode *inode = NULL;
 #ifdef PRJ4
-  char *ret_ptr, *next_ptr;
-  disk_sector_t inode_sector = 0;
-  struct thread *tcurrent = thread_current ();
-
-  ret_ptr = palloc_get_page (PAL_ZERO);
-  if (!ret_ptr)
-    return NULL;
-  char** ptpt = malloc (sizeof (char**));
-  memcpy (ptpt, &ret_ptr, sizeof (char**));
-  strlcpy (ret_ptr, name, PGSIZE);
+  char leaf[NAME_MAX + 1];
 
-  if (name[0] == '/') // absolute path
-    dir = dir_open_root ();
-  else // relative path
-    dir = dir_open (inode_open (tcurrent->current_dir));
-  if (dir == NULL)
-  {
-    palloc_free_page (ret_ptr);
+  if (!resolve (name, &dir, leaf, &inode))
     return NULL;
-  }
-
-  for (ret_ptr = strtok_r (ret_ptr , "/", &next_ptr);
-      ret_ptr != NULL;
-      ret_ptr = strtok_r (NULL, "/", &next_ptr))
-  {
-    if (!dir_lookup (dir, ret_ptr, &inode))
-    {
-      /* 중간인데 못찾으면 return NULL*/
-      dir_close (dir);
-      palloc_free_page (*ptpt);
-      free (ptpt);
-      return NULL;
-    }
-    dir_close (dir);
-    if (next_ptr[0] != '\0')
-    {
-      dir = dir_open (inode);
-      if (!dir)
-      {
-        palloc_free_page (*ptpt);
-        free (ptpt);
-        return NULL;
-      }
-    }
-  }
- 
-  if (inode == NULL && name[0] == '/')
-    inode = inode_open (ROOT_DIR_SECTOR);
-
-  palloc_free_page (*ptpt);
-  free (ptpt);
+  dir_close (dir);
 #else
   dir = dir_open_root ();
   if (dir != NULL)
@@ -233,69 +151,197 @@ filesys_remove (const char *name)
   struct dir *dir;
   bool success = false;
 #ifdef PRJ4
-  char *ret_ptr, *next_ptr;
+  char leaf[NAME_MAX + 1];
+
+  if (!resolve (name, &dir, leaf, NULL))
+    return false;
+  journal_begin ();
+  success = leaf[0] != '\0' && dir_remove (dir, leaf);
+  journal_end ();
+  dir_close (dir); 
+#else
+  dir = dir_open_root ();
+  success = dir_remove (dir, name);
+  dir_close (dir); 
+#endif
+
+  return dir != NULL && success;
+}
+
+#ifdef PRJ4
+/* Changes the current directory of the running thread to the
+   directory named NAME.
+   Returns true if successful, false if NAME does not exist or
+   is not a directory. */
+bool
+filesys_chdir (const char *name)
+{
+  char leaf[NAME_MAX + 1];
+  struct dir *dir;
   struct inode *inode;
-  disk_sector_t inode_sector = 0;
-  struct thread *tcurrent = thread_current ();
+  bool success;
 
-  ret_ptr = palloc_get_page (PAL_ZERO);
-  if (!ret_ptr) return false;
-  char** ptpt = malloc (sizeof (char**));
-  memcpy (ptpt, &ret_ptr, sizeof (char**));
-  strlcpy (ret_ptr, name, PGSIZE);
+  if (!resolve (name, &dir, leaf, &inode))
+    return false;
+  dir_close (dir);
 
-  if (name[0] == '/') // absolute path
-    dir = dir_open_root ();
-  else // relative path
-    dir = dir_open (inode_open (tcurrent->current_dir));
-  if (dir == NULL)
+  success = inode != NULL && inode_is_directory (inode);
+  if (success)
+    thread_current ()->current_dir = inode_get_inumber (inode);
+  inode_close (inode);
+  return success;
+}
+
+/* Creates a directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if NAME already exists, if its parent does not, or if
+   the disk is full. */
+bool
+filesys_mkdir (const char *name)
+{
+  char leaf[NAME_MAX + 1];
+  struct dir *dir;
+  struct inode *inode;
+  disk_sector_t sector;
+  bool success = false;
+
+  if (!resolve (name, &dir, leaf, &inode))
+    return false;
+  journal_begin ();
+  if (leaf[0] == '\0' || inode != NULL)
   {
-    palloc_free_page (ret_ptr);
-    return NULL;
+    inode_close (inode);
+    goto done;
+  }
+  if (!free_map_allocate (1, &sector))
+    goto done;
+  if (!dir_create (sector, inode_get_inumber (dir_get_inode (dir)), 16))
+  {
+    free_map_release (sector, 1);
+    goto done;
+  }
+  if (!dir_add (dir, leaf, sector))
+  {
+    /* Removing the last opener frees the new directory. */
+    inode = inode_open (sector);
+    inode_remove (inode);
+    inode_close (inode);
+    goto done;
   }
+  success = true;
+
+done:
+  journal_end ();
+  dir_close (dir);
+  return success;
+}
+
+/* Copies the next file name component of *SRCP into PART, which
+   holds NAME_MAX + 1 bytes, and advances *SRCP past it.
+   Returns 1 if successful, 0 at the end of the path, -1 if the
+   component is longer than NAME_MAX. */
+static int
+next_part (char part[NAME_MAX + 1], const char **srcp)
+{
+  const char *src = *srcp;
+  char *dst = part;
 
-  for (ret_ptr = strtok_r (ret_ptr , "/", &next_ptr);
-      ret_ptr != NULL;
-      ret_ptr = strtok_r (NULL, "/", &next_ptr))
+  /* Skip leading slashes.  If it's all slashes, we're done. */
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
+
+  /* Copy up to NAME_MAX characters from SRC to DST. */
+  while (*src != '/' && *src != '\0')
   {
-    if (next_ptr[0] == '\0')
-    {
-      success= true;
-      break;
-    }
-    if (!dir_lookup (dir, ret_ptr, &inode))
-    {
-      /* 중간인데 못찾으면 return NULL*/
-      success = false;
-      break;
-    }
-    dir_close (dir);
-    dir = dir_open (inode);
-    if (!dir)
+    if (dst < part + NAME_MAX)
+      *dst++ = *src;
+    else
+      return -1;
+    src++;
+  }
+  *dst = '\0';
+
+  *srcp = src;
+  return 1;
+}
+
+/* Walks path NAME, starting at the root directory if it begins
+   with "/" and at the current directory otherwise.
+   If every component but the last names a directory, stores the
+   open directory holding the last component into *DIRP, which
+   the caller must close, copies the last component into LEAF,
+   and returns true.  If INODEP is non-null, also looks up the
+   last component and stores its inode, or a null pointer if
+   there is none, into *INODEP; the caller must close it.
+   A path with no components, such as "/", leaves LEAF empty,
+   and in that case *INODEP is the starting directory if the
+   path was absolute.
+   Returns false, with nothing left open, if the walk fails.
+
+   Components are copied one at a time into buffers on the
+   stack, so a walk needs no allocation beyond what looking up
+   each component takes. */
+static bool
+resolve (const char *name, struct dir **dirp, char leaf[NAME_MAX + 1],
+         struct inode **inodep)
+{
+  char part[NAME_MAX + 1];
+  bool absolute = name[0] == '/';
+  struct dir *dir;
+  struct inode *inode;
+  int result;
+
+  if (absolute)
+    dir = dir_open_root ();
+  else
+    dir = dir_open (inode_open (thread_current ()->current_dir));
+  if (dir == NULL)
+    return false;
+
+  leaf[0] = '\0';
+  while ((result = next_part (part, &name)) > 0)
+  {
+    if (leaf[0] != '\0')
     {
-      palloc_free_page (*ptpt);
-      free (ptpt);
-      return false;
+      /* The previous component must be a directory to descend
+         into. */
+      if (!dir_lookup (dir, leaf, &inode))
+        goto fail;
+      if (!inode_is_directory (inode))
+      {
+        inode_close (inode);
+        goto fail;
+      }
+      dir_close (dir);
+      dir = dir_open (inode);
+      if (dir == NULL)
+        return false;
     }
-
+    strlcpy (leaf, part, NAME_MAX + 1);
   }
+  if (result < 0)
+    goto fail;
 
-  /* 디렉토리에 뭐 있으면 안됨 */
+  if (inodep != NULL)
+  {
+    if (leaf[0] != '\0')
+      dir_lookup (dir, leaf, inodep);
+    else if (absolute)
+      *inodep = inode_reopen (dir_get_inode (dir));
+    else
+      *inodep = NULL;
+  }
+  *dirp = dir;
+  return true;
 
-  if (success)
-    success = dir_remove (dir, ret_ptr);
-  dir_close (dir); 
-  palloc_free_page (*ptpt);
-  free (ptpt);
-#else
-  dir = dir_open_root ();
-  success = dir_remove (dir, name);
-  dir_close (dir); 
+fail:
+  dir_close (dir);
+  return false;
+}
 #endif
 
-  return dir != NULL && success;
-}
-
 /* Formats the file system. */
 static void
 do_format (void)
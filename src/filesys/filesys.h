@@ -7,6 +7,9 @@
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#ifdef PRJ4
+#define SUPERBLOCK_SECTOR 2     /* Superblock sector. */
+#endif
 
 #ifndef THREADS_THREAD_H
 #include "threads/thread.h"
@@ -23,5 +26,9 @@ void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+#ifdef PRJ4
+bool filesys_chdir (const char *name);
+bool filesys_mkdir (const char *name);
+#endif
 
 #endif /* filesys/filesys.h */
@@ -1,12 +1,35 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "filesys/super.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct lock free_map_lock;    /* Guards free_map and its file. */
+#ifdef PRJ4
+static struct bitmap *freed;         /* Released since the last commit. */
+
+/* The free map is read in a group at a time, when a group is
+   first needed, so that mounting does not read all of it.  The
+   bits of a group not read in yet are all kept set, so nothing
+   is ever allocated from one by accident.  Which group to try
+   first comes from the free counts in the superblock. */
+static struct bitmap *loaded;        /* Groups read in so far. */
+static size_t next_group;            /* Group to try first. */
+
+static size_t group_cnt (void);
+static size_t group_start (size_t group);
+static size_t group_size (size_t group);
+static void load_group (size_t group);
+static bool write_groups (disk_sector_t, size_t cnt);
+static void count_groups (void);
+#endif
 
 /* Initializes the free map. */
 void
@@ -15,8 +38,17 @@ free_map_init (void)
   free_map = bitmap_create (disk_size (filesys_disk));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--disk is too large");
+  lock_init (&free_map_lock);
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+#ifdef PRJ4
+  bitmap_mark (free_map, SUPERBLOCK_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+  freed = bitmap_create (disk_size (filesys_disk));
+  loaded = bitmap_create (group_cnt ());
+  if (freed == NULL || loaded == NULL)
+    PANIC ("bitmap creation failed--disk is too large");
+#endif
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -26,7 +58,39 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) 
 {
-  disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  disk_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+#ifdef PRJ4
+  {
+    size_t i, g = next_group;
+
+    /* Skip groups the superblock says are too full. */
+    sector = BITMAP_ERROR;
+    for (i = 0; i < group_cnt () && sector == BITMAP_ERROR; i++)
+    {
+      g = (next_group + i) % group_cnt ();
+      if (super_group_free (g) < cnt)
+        continue;
+      load_group (g);
+      sector = bitmap_scan_and_flip (free_map, group_start (g), cnt, false);
+    }
+    if (sector != BITMAP_ERROR
+        && free_map_file != NULL
+        && !write_groups (sector, cnt))
+      {
+        bitmap_set_multiple (free_map, sector, cnt, false);
+        sector = BITMAP_ERROR;
+      }
+    if (sector != BITMAP_ERROR)
+    {
+      next_group = g;
+      for (i = 0; i < cnt; i++)
+        super_add_free ((sector + i) / SUPER_GROUP_SECTORS, -1);
+    }
+  }
+#else
+  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
       && !bitmap_write (free_map, free_map_file))
@@ -34,29 +98,146 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp)
       bitmap_set_multiple (free_map, sector, cnt, false); 
       sector = BITMAP_ERROR;
     }
+#endif
+  lock_release (&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use.  With
+   the journal, they only become available once the release is
+   committed, because until then the file system on disk may
+   still be using them. */
 void
 free_map_release (disk_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
+#ifdef PRJ4
+  bitmap_set_multiple (freed, sector, cnt, true);
+#else
   bitmap_set_multiple (free_map, sector, cnt, false);
   bitmap_write (free_map, free_map_file);
+#endif
+  lock_release (&free_map_lock);
+}
+
+#ifdef PRJ4
+/* Marks the sectors released since the last call free, as part
+   of the group the journal is committing. */
+void
+free_map_commit (void)
+{
+  size_t g, i;
+
+  lock_acquire (&free_map_lock);
+  for (g = 0; g < group_cnt (); g++)
+  {
+    size_t start = group_start (g), size = group_size (g);
+    size_t cnt = bitmap_count (freed, start, size, true);
+
+    if (cnt == 0)
+      continue;
+    load_group (g);
+    for (i = start; i < start + size; i++)
+      if (bitmap_test (freed, i))
+        bitmap_reset (free_map, i);
+    bitmap_set_multiple (freed, start, size, false);
+    write_groups (start, size);
+    super_add_free (g, cnt);
+  }
+  lock_release (&free_map_lock);
+}
+
+/* Returns the number of groups on the disk. */
+static size_t
+group_cnt (void)
+{
+  return DIV_ROUND_UP (bitmap_size (free_map), SUPER_GROUP_SECTORS);
+}
+
+/* Returns the first sector in GROUP. */
+static size_t
+group_start (size_t group)
+{
+  return group * SUPER_GROUP_SECTORS;
+}
+
+/* Returns the number of sectors in GROUP, which is less than
+   SUPER_GROUP_SECTORS only for the last one. */
+static size_t
+group_size (size_t group)
+{
+  size_t left = bitmap_size (free_map) - group_start (group);
+  return left < SUPER_GROUP_SECTORS ? left : SUPER_GROUP_SECTORS;
 }
 
-/* Opens the free map file and reads it from disk. */
+/* Reads GROUP of the free map in from disk, unless it was
+   already.  While formatting there is nothing on disk to read,
+   and the free map in memory is right as it is. */
+static void
+load_group (size_t group)
+{
+  if (bitmap_test (loaded, group))
+    return;
+  if (free_map_file != NULL
+      && !bitmap_read_range (free_map, free_map_file, group_start (group),
+                             group_size (group)))
+    PANIC ("can't read free map");
+  bitmap_mark (loaded, group);
+}
+
+/* Writes each group of the free map holding one of the CNT
+   sectors from SECTOR on to disk. */
+static bool
+write_groups (disk_sector_t sector, size_t cnt)
+{
+  size_t g;
+
+  for (g = sector / SUPER_GROUP_SECTORS;
+       g <= (sector + cnt - 1) / SUPER_GROUP_SECTORS; g++)
+    if (!bitmap_write_range (free_map, free_map_file, group_start (g),
+                             group_size (g)))
+      return false;
+  return true;
+}
+
+/* Stores the free count of every group into the superblock. */
+static void
+count_groups (void)
+{
+  size_t g;
+
+  for (g = 0; g < group_cnt (); g++)
+    super_set_group_free (g, bitmap_count (free_map, group_start (g),
+                                           group_size (g), false));
+}
+#endif
+
+/* Opens the free map file and reads it from disk.  After a clean
+   unmount, the free map is read in later, a group at a time, and
+   the free counts come from the superblock as they are. */
 void
 free_map_open (void) 
 {
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+#ifdef PRJ4
+  if (super_was_clean ())
+  {
+    bitmap_set_all (free_map, true);
+    bitmap_set_all (loaded, false);
+    return;
+  }
+#endif
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+#ifdef PRJ4
+  bitmap_set_all (loaded, true);
+  count_groups ();
+#endif
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -85,4 +266,8 @@ free_map_create (void)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+#ifdef PRJ4
+  bitmap_set_all (loaded, true);
+  count_groups ();
+#endif
 }
@@ -13,5 +13,8 @@ void free_map_close (void);
 
 bool free_map_allocate (size_t, disk_sector_t *);
 void free_map_release (disk_sector_t, size_t);
+#ifdef PRJ4
+void free_map_commit (void);
+#endif
 
 #endif /* filesys/free-map.h */
@@ -1,5 +1,8 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,6 +14,19 @@
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 
+/* Pages of buffer fsutil_put() and fsutil_get() copy through,
+   and the number of scratch disk sectors that fill it.  Each
+   fill is a single disk command. */
+#define COPY_PAGES 16
+#define COPY_SECTORS (COPY_PAGES * PGSIZE / DISK_SECTOR_SIZE)
+
+/* Next scratch disk sector fsutil_put() or fsutil_extract() will
+   read. */
+static disk_sector_t put_sector;
+
+static void copy_in (struct disk *, struct file *, off_t size,
+                     void *buffer, const char *file_name);
+
 /* List files in the root directory. */
 void
 fsutil_ls (char **argv UNUSED) 
@@ -76,13 +92,12 @@ fsutil_rm (char **argv)
 
    The first call to this function will read starting at the
    beginning of the scratch disk.  Later calls advance across the
-   disk.  This disk position is independent of that used for
-   fsutil_get(), so all `put's should precede all `get's. */
+   disk.  This disk position is shared with fsutil_extract() but
+   independent of that used for fsutil_get(), so all `put's
+   should precede all `get's. */
 void
 fsutil_put (char **argv) 
 {
-  static disk_sector_t sector = 0;
-
   const char *file_name = argv[1];
   struct disk *src;
   struct file *dst;
@@ -92,9 +107,7 @@ fsutil_put (char **argv)
   printf ("Putting '%s' into the file system...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
-  if (buffer == NULL)
-    PANIC ("couldn't allocate buffer");
+  buffer = palloc_get_multiple (PAL_ASSERT, COPY_PAGES);
 
   /* Open source disk and read file size. */
   src = disk_get (1, 0);
@@ -102,14 +115,15 @@ fsutil_put (char **argv)
     PANIC ("couldn't open source disk (hdc or hd1:0)");
 
   /* Read file size. */
-  disk_read (src, sector++, buffer);
+  disk_read (src, put_sector++, buffer);
   if (memcmp (buffer, "PUT", 4))
     PANIC ("%s: missing PUT signature on scratch disk", file_name);
   size = ((int32_t *) buffer)[1];
   if (size < 0)
     PANIC ("%s: invalid file size %d", file_name, size);
   
-  /* Create destination file. */
+  /* Create destination file, with all of its sectors allocated
+     up front so that the copy never has to grow it. */
   if (!filesys_create (file_name, size))
     PANIC ("%s: create failed", file_name);
   dst = filesys_open (file_name);
@@ -117,19 +131,38 @@ fsutil_put (char **argv)
     PANIC ("%s: open failed", file_name);
 
   /* Do copy. */
+  copy_in (src, dst, size, buffer, file_name);
+
+  /* Finish up. */
+  file_close (dst);
+  palloc_free_multiple (buffer, COPY_PAGES);
+}
+
+/* Copies SIZE bytes from the scratch disk SRC, starting at
+   put_sector, to DST, COPY_SECTORS sectors at a time through
+   BUFFER, and advances put_sector past them.  FILE_NAME is used
+   in error messages. */
+static void
+copy_in (struct disk *src, struct file *dst, off_t size, void *buffer,
+         const char *file_name)
+{
   while (size > 0)
     {
-      int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-      disk_read (src, sector++, buffer);
+      size_t sector_cnt = DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
+      int chunk_size;
+
+      if (sector_cnt > COPY_SECTORS)
+        sector_cnt = COPY_SECTORS;
+      chunk_size = sector_cnt * DISK_SECTOR_SIZE;
+      if (chunk_size > size)
+        chunk_size = size;
+      disk_read_multiple (src, put_sector, sector_cnt, buffer);
+      put_sector += sector_cnt;
       if (file_write (dst, buffer, chunk_size) != chunk_size)
         PANIC ("%s: write failed with %"PROTd" bytes unwritten",
                file_name, size);
       size -= chunk_size;
     }
-
-  /* Finish up. */
-  file_close (dst);
-  free (buffer);
 }
 
 /* Copies file FILE_NAME from the file system to the scratch disk.
@@ -157,9 +190,7 @@ fsutil_get (char **argv)
   printf ("Getting '%s' from the file system...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
-  if (buffer == NULL)
-    PANIC ("couldn't allocate buffer");
+  buffer = palloc_get_multiple (PAL_ASSERT, COPY_PAGES);
 
   /* Open source file. */
   src = filesys_open (file_name);
@@ -178,20 +209,203 @@ fsutil_get (char **argv)
   ((int32_t *) buffer)[1] = size;
   disk_write (dst, sector++, buffer);
   
-  /* Do copy. */
+  /* Do copy, COPY_SECTORS sectors at a time. */
   while (size > 0) 
     {
-      int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-      if (sector >= disk_size (dst))
+      size_t sector_cnt = DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
+      int chunk_size;
+
+      if (sector_cnt > COPY_SECTORS)
+        sector_cnt = COPY_SECTORS;
+      chunk_size = sector_cnt * DISK_SECTOR_SIZE;
+      if (chunk_size > size)
+        chunk_size = size;
+      if (sector + sector_cnt > disk_size (dst))
         PANIC ("%s: out of space on scratch disk", file_name);
       if (file_read (src, buffer, chunk_size) != chunk_size)
         PANIC ("%s: read failed with %"PROTd" bytes unread", file_name, size);
-      memset (buffer + chunk_size, 0, DISK_SECTOR_SIZE - chunk_size);
-      disk_write (dst, sector++, buffer);
+      memset (buffer + chunk_size, 0,
+              sector_cnt * DISK_SECTOR_SIZE - chunk_size);
+      disk_write_multiple (dst, sector, sector_cnt, buffer);
+      sector += sector_cnt;
       size -= chunk_size;
     }
 
   /* Finish up. */
   file_close (src);
-  free (buffer);
+  palloc_free_multiple (buffer, COPY_PAGES);
+}
+
+/* Longest file name a ustar header can hold: a 155-byte prefix,
+   a "/", and a 100-byte name. */
+#define USTAR_NAME_MAX 256
+
+/* Parses the octal number in the LEN bytes at FIELD and stores
+   it in *VALUE.  Returns true if successful, false if it is not
+   a well-formed octal number. */
+static bool
+parse_octal (const char *field, size_t len, unsigned long *value)
+{
+  const char *p = field, *end = field + len;
+  bool digits = false;
+
+  while (p < end && *p == ' ')
+    p++;
+  for (*value = 0; p < end && *p >= '0' && *p <= '7'; p++)
+    {
+      if (*value > ULONG_MAX / 8)
+        return false;
+      *value = *value * 8 + (*p - '0');
+      digits = true;
+    }
+  return digits && (p == end || *p == ' ' || *p == '\0');
+}
+
+/* Parses ustar HEADER.  On success, stores the file's name
+   without any leading "/" or "./" or trailing "/" into NAME,
+   which has room for USTAR_NAME_MAX + 1 bytes, its type flag
+   into *TYPE, and its size into *SIZE, and returns true.
+   Returns false at the end of the archive.  PANICs if HEADER is
+   not a valid ustar header. */
+static bool
+parse_header (const char *header, char *name, char *type, off_t *size)
+{
+  unsigned long chksum, value;
+  const char *p;
+  size_t i;
+
+  /* An all-zero block ends the archive. */
+  for (i = 0; i < DISK_SECTOR_SIZE; i++)
+    if (header[i] != '\0')
+      break;
+  if (i == DISK_SECTOR_SIZE)
+    return false;
+
+  if (memcmp (header + 257, "ustar", 5))            /* magic */
+    PANIC ("no ustar header at scratch disk sector %"PRDSNu,
+           put_sector - 1);
+  if (!parse_octal (header + 148, 8, &chksum))      /* chksum */
+    PANIC ("bad ustar header checksum");
+  for (value = i = 0; i < DISK_SECTOR_SIZE; i++)
+    value += i >= 148 && i < 156 ? ' ' : (uint8_t) header[i];
+  if (value != chksum)
+    PANIC ("ustar header checksum mismatch");
+  if (!parse_octal (header + 124, 12, &value)       /* size */
+      || value > INT32_MAX)
+    PANIC ("bad ustar file size");
+  *size = value;
+  *type = header[156];                              /* typeflag */
+
+  /* Join prefix and name, neither of which need be null
+     terminated. */
+  name[0] = '\0';
+  if (header[345] != '\0')                          /* prefix */
+    {
+      strlcpy (name, header + 345, 155 + 1);
+      strlcat (name, "/", USTAR_NAME_MAX + 1);
+    }
+  i = strlen (name);
+  strlcpy (name + i, header, 100 + 1);              /* name */
+
+  /* Drop leading "/" and "./", and a trailing "/". */
+  for (p = name; *p == '/' || !memcmp (p, "./", 2); )
+    p += *p == '/' ? 1 : 2;
+  memmove (name, p, strlen (p) + 1);
+  i = strlen (name);
+  if (i > 0 && name[i - 1] == '/')
+    name[i - 1] = '\0';
+  return true;
+}
+
+/* Extracts the ustar archive at the current position on the
+   scratch disk, hdc or hd1:0, into the file system.
+
+   The archive must be preceded by a sector holding the string
+   "TAR\0" followed by the archive size in bytes as a 32-bit,
+   little-endian integer.  Regular files and, with subdirectory
+   support, directories are extracted; anything else is skipped.
+   GNU long name and pax extended headers would change the name
+   or size of the entry after them, so they stop the kernel
+   rather than being skipped; create archives with
+   "tar --format=ustar".
+   A file is created at its full size before its data is copied
+   in, so all of its sectors are allocated in one pass.
+
+   This uses the same disk position as fsutil_put(), and
+   advances it past the archive. */
+void
+fsutil_extract (char **argv UNUSED) 
+{
+  char name[USTAR_NAME_MAX + 1];
+  disk_sector_t end;
+  struct disk *src;
+  char *buffer;
+  char type;
+  off_t size;
+  int32_t archive_size;
+
+  /* Open source disk and read archive size. */
+  src = disk_get (1, 0);
+  if (src == NULL)
+    PANIC ("couldn't open source disk (hdc or hd1:0)");
+  buffer = palloc_get_multiple (PAL_ASSERT, COPY_PAGES);
+  disk_read (src, put_sector++, buffer);
+  if (memcmp (buffer, "TAR", 4))
+    PANIC ("missing TAR signature on scratch disk");
+  archive_size = ((int32_t *) buffer)[1];
+  if (archive_size < 0)
+    PANIC ("invalid archive size %"PRId32, archive_size);
+  end = put_sector + DIV_ROUND_UP (archive_size, DISK_SECTOR_SIZE);
+
+  printf ("Extracting archive from the scratch disk...\n");
+  while (put_sector < end)
+    {
+      disk_read (src, put_sector++, buffer);
+      if (!parse_header (buffer, name, &type, &size))
+        break;
+
+      if (type == '5')
+        {
+          /* "./" leaves an empty name: the root directory. */
+#ifdef PRJ4
+          struct file *dir = name[0] != '\0' ? filesys_open (name) : NULL;
+
+          if (name[0] != '\0' && dir == NULL)
+            {
+              printf ("Making directory '%s'...\n", name);
+              if (!filesys_mkdir (name))
+                PANIC ("%s: mkdir failed", name);
+            }
+          file_close (dir);
+#else
+          if (name[0] != '\0')
+            printf ("%s: ignoring directory\n", name);
+#endif
+        }
+      else if (type == '0' || type == '\0')
+        {
+          struct file *dst;
+
+          printf ("Putting '%s' into the file system...\n", name);
+          if (!filesys_create (name, size))
+            PANIC ("%s: create failed", name);
+          dst = filesys_open (name);
+          if (dst == NULL)
+            PANIC ("%s: open failed", name);
+          copy_in (src, dst, size, buffer, name);
+          file_close (dst);
+          continue;
+        }
+      else if (type == 'L' || type == 'K' || type == 'x' || type == 'g')
+        PANIC ("%s: unsupported extended header of type '%c'", name, type);
+      else
+        printf ("%s: ignoring file of type '%c'\n", name, type);
+
+      /* Skip the data of anything not copied. */
+      put_sector += DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
+    }
+
+  /* Skip the end-of-archive blocks and any padding. */
+  put_sector = end;
+  palloc_free_multiple (buffer, COPY_PAGES);
 }
@@ -1,17 +1,30 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/super.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#ifdef PRJ3
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "vm/pagecache.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 #ifdef PRJ4
 #define IS_DIRECTORY(INFO) (INFO & 0x00000001)
-#define GET_LEVEL(INFO) (INFO >> 1)
+#define INODE_INLINE 0x80000000         /* File data lives in the inode. */
+#define INODE_UNWRITTEN 0x40000000      /* May map unwritten sectors. */
+#define INODE_MAP_FLAGS (INODE_INLINE | INODE_UNWRITTEN)
+#define INODE_FLAGS (INODE_MAP_FLAGS | INODE_DIR_COMPACT | INODE_DIR_INDEX)
+#define IS_INLINE(INFO) (INFO & INODE_INLINE)
+#define GET_LEVEL(INFO) ((INFO & ~INODE_FLAGS) >> 1)
 #define SET_LEVEL(INFO, LEVEL) (INFO | (LEVEL << 1))
 #endif
 
@@ -34,20 +47,41 @@ struct inode_disk
     int32_t doubly_indirect;
 #else
 #define DIRECT_NO 123
-    int32_t direct[DIRECT_NO];
+    int32_t direct[DIRECT_NO];          /* Or file data, if inline. */
     int32_t indirect;
 #endif
     unsigned magic;                     /* Magic number. */
 #endif
   };
 
+#if defined (PRJ4) && !defined (INDEXED_STRUCTURE)
+/* Small files keep their content in the space of direct[]
+   instead of in data sectors, so reading them costs no lookup
+   beyond the inode itself.  A write past INODE_INLINE_MAX
+   converts the inode to the usual block mapping. */
+#define INODE_INLINE_MAX (DIRECT_NO * sizeof (int32_t))
+#define INLINE_DATA(DISK) ((uint8_t *) (DISK)->direct)
+
+/* A block-map entry with this bit set names a sector that was
+   preallocated by inode_fallocate() but never written.  Its
+   on-disk content is garbage and reads as zeros. */
+#define SECTOR_UNWRITTEN 0x40000000
+#define SECTOR_NO(ENTRY) ((ENTRY) & ~SECTOR_UNWRITTEN)
+
+/* Most bytes of data one journal operation writes, allocates or
+   releases.  Larger requests are split into operations of this
+   size, so that one never pins more chain links in the buffer
+   cache than journal_begin() leaves room for.  A whole number of
+   chain links. */
+#define INODE_BATCH (8 * DIRECT_NO * DISK_SECTOR_SIZE)
+#endif
+
 #ifdef INDEXED_STRUCTURE
 struct indirect_inode_disk
 {
   int32_t direct[128];
 };
 #endif
-static struct lock inode_sys_lock;
 
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
@@ -62,14 +96,51 @@ static char zeros[DISK_SECTOR_SIZE];
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     disk_sector_t sector;               /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
+    bool loading;                       /* True while being read in. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rwlock dir_lock;             /* Guards a directory's entries. */
+#ifdef PRJ4
+    struct rwlock rw_lock;              /* Guards length and block map. */
+#ifndef INDEXED_STRUCTURE
+    struct lock cursor_lock;            /* Guards the cursor below. */
+    size_t cursor_idx;                  /* Last chain link looked up, */
+    disk_sector_t cursor_sector;        /* ...and its sector. */
+#endif
+#endif
     struct inode_disk data;             /* Inode content. */
   };
 
+static off_t inode_write_at_locked (struct inode *, const void *, off_t,
+                                    off_t);
+#ifdef PRJ3
+static off_t inode_read_user (struct inode *, uint8_t *, off_t, off_t);
+static off_t inode_write_user (struct inode *, const uint8_t *, off_t, off_t);
+#endif
+#ifdef PRJ4
+static off_t inode_write_batch (struct inode *, const void *, off_t, off_t);
+static bool inode_is_meta (struct inode *);
+#endif
+
+#if defined (PRJ4) && !defined (INDEXED_STRUCTURE)
+static bool inode_create_inline (disk_sector_t, off_t, uint32_t);
+static off_t inode_write_inline (struct inode *, const void *, off_t, off_t);
+static bool inode_convert_inline (struct inode *);
+static void inode_chain_link (struct inode *, size_t, struct inode_disk *);
+static void release_chain (disk_sector_t, size_t, size_t);
+static disk_sector_t inode_written (struct inode *, struct inode_disk *,
+                                    size_t, bool);
+static bool inode_extend (struct inode *, off_t, bool);
+static bool inode_fallocate_batch (struct inode *, off_t, bool *);
+static off_t inode_copy_batch (struct inode *, off_t, struct inode *, off_t,
+                               off_t, struct inode_disk *, struct inode_disk *);
+static off_t inode_copy_bounce (struct inode *, off_t, struct inode *, off_t,
+                                off_t);
+#endif
+
 /* Returns the disk sector that contains byte offset POS within
    INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -86,18 +157,37 @@ byte_to_sector (const struct inode *inode, off_t pos)
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Table of open inodes keyed by sector, so that opening a single
+   inode twice returns the same `struct inode'.  open_inodes_lock
+   guards the table and every inode's open_cnt, deny_write_cnt and
+   loading.  inode_loaded is signaled when an inode stops loading. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+static struct condition inode_loaded;
+
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return hash_entry (a, struct inode, elem)->sector
+         < hash_entry (b, struct inode, elem)->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  lock_init (&open_inodes_lock);
+  cond_init (&inode_loaded);
 #ifdef PRJ4
   buffer_cache_init ();
-  lock_init (&inode_sys_lock);
 #endif
 }
 
@@ -117,12 +207,36 @@ inode_create (disk_sector_t sector, off_t length, uint32_t info)
   head_disk->length = 0;
   head_disk->info = info;
   bool success = allocate_inode_disk (length, head_disk);
-  buffer_cache_write (sector, head_disk, DISK_SECTOR_SIZE, 0);
+  buffer_cache_write_meta (sector, head_disk, DISK_SECTOR_SIZE, 0);
   free (head_disk);
+  if (success)
+    super_add_inodes (1);
   return success;
 #else
-  size_t sectors = bytes_to_sectors (length);
-  return allocate_inode_disk (sectors, sector, length, 0, info, sector, sectors);
+  struct inode_disk *disk_inode = NULL;
+
+  if ((size_t) length <= INODE_INLINE_MAX)
+    return inode_create_inline (sector, length, info);
+
+  ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
+  disk_inode = calloc (1, sizeof *disk_inode);
+  if (disk_inode == NULL)
+    return false;
+  disk_inode->sector = sector;
+  disk_inode->info = info;
+  disk_inode->magic = INODE_MAGIC;
+  if (!allocate_inode_disk (sector, disk_inode, 0, bytes_to_sectors (length),
+                            false))
+  {
+    free (disk_inode);
+    return false;
+  }
+  buffer_cache_read (sector, disk_inode, DISK_SECTOR_SIZE, 0);
+  disk_inode->length = length;
+  buffer_cache_write_meta (sector, disk_inode, DISK_SECTOR_SIZE, 0);
+  free (disk_inode);
+  super_add_inodes (1);
+  return true;
 #endif
 }
 #else
@@ -167,37 +281,60 @@ inode_create (disk_sector_t sector, off_t length)
 struct inode *
 inode_open (disk_sector_t sector) 
 {
-  struct list_elem *e;
+  struct hash_elem *e;
   struct inode *inode;
+  struct inode key;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  key.sector = sector;
+  lock_acquire (&open_inodes_lock);
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      while (inode->loading)
+        cond_wait (&inode_loaded, &open_inodes_lock);
+      lock_release (&open_inodes_lock);
+      return inode; 
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  The inode is read with the table unlocked, so
+     that opening and closing other inodes does not wait for the
+     disk.  Until it is read, it is marked loading and anybody
+     else opening it waits above. */
+  hash_insert (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->loading = true;
+  lock_release (&open_inodes_lock);
+  rwlock_init (&inode->dir_lock);
 #ifdef PRJ4
+  rwlock_init (&inode->rw_lock);
+#ifndef INDEXED_STRUCTURE
+  lock_init (&inode->cursor_lock);
+  inode->cursor_idx = 0;
+  inode->cursor_sector = sector;
+#endif
   buffer_cache_read (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
 #else
   disk_read (filesys_disk, inode->sector, &inode->data);
 #endif
+
+  lock_acquire (&open_inodes_lock);
+  inode->loading = false;
+  cond_broadcast (&inode_loaded, &open_inodes_lock);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -206,7 +343,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -217,6 +358,37 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns true if INODE has been removed but is still open. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
+/* Locks the entries of directory INODE, shared for lookups and
+   listings or EXCLUSIVE for adding and removing entries.  A
+   thread that holds a directory's lock may also lock one of its
+   subdirectories, never the other way around. */
+void
+inode_lock_dir (struct inode *inode, bool exclusive)
+{
+  if (exclusive)
+    rwlock_acquire_write (&inode->dir_lock);
+  else
+    rwlock_acquire_read (&inode->dir_lock);
+}
+
+/* Releases a lock taken by inode_lock_dir() with the same
+   EXCLUSIVE. */
+void
+inode_unlock_dir (struct inode *inode, bool exclusive)
+{
+  if (exclusive)
+    rwlock_release_write (&inode->dir_lock);
+  else
+    rwlock_release_read (&inode->dir_lock);
+}
+
 #ifdef PRJ4
 uint32_t
 inode_get_info (struct inode *inode)
@@ -230,6 +402,16 @@ inode_is_directory (struct inode *inode)
   return IS_DIRECTORY (inode->data.info);
 }
 
+/* Returns true if INODE's contents are metadata, which the
+   journal commits, rather than plain file data. */
+static bool
+inode_is_meta (struct inode *inode)
+{
+  return (inode_is_directory (inode)
+          || (inode->data.info & INODE_DIR_INDEX) != 0
+          || inode->sector == FREE_MAP_SECTOR);
+}
+
 uint32_t
 inode_get_level (struct inode *inode)
 {
@@ -255,36 +437,44 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt > 0)
     {
-#ifndef PRJ4
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
-      if (inode->removed) 
-        {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
-        }
+      lock_release (&open_inodes_lock);
+      return;
+    }
+  hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
 
-      free (inode); 
+#ifdef PRJ3
+  /* Its pages must not outlive the file in the page cache. */
+  if (inode->removed)
+    pcache_drop (inode->sector);
+#endif
+
+#ifndef PRJ4
+  /* Deallocate blocks if removed. */
+  if (inode->removed) 
+    {
+      free_map_release (inode->sector, 1);
+      free_map_release (inode->data.start,
+                        bytes_to_sectors (inode->data.length)); 
+    }
 #else
-      list_remove (&inode->elem);
-      uint32_t sector_no = bytes_to_sectors (inode->data.length);
-      if (inode->removed) 
-      {
+  uint32_t sector_no = bytes_to_sectors (inode->data.length);
+  if (inode->removed) 
+  {
 #ifdef INDEXED_STRUCTURE
-        release_inode_disk (sector_no, &inode->data);
+    release_inode_disk (sector_no, &inode->data);
 #else
-        release_inode_disk (sector_no, inode->sector);
+    if (!IS_INLINE (inode->data.info))
+      release_inode_disk (sector_no, inode->sector);
 #endif
-        free_map_release (inode->sector, 1);
-      }
-      free (inode);
+    free_map_release (inode->sector, 1);
+    super_add_inodes (-1);
+  }
 #endif
-    }
+  free (inode); 
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -305,16 +495,39 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
 
+#ifdef PRJ3
+  if (is_user_vaddr (buffer))
+    return inode_read_user (inode, buffer, size, offset);
+#endif
 #ifdef PRJ4
-  lock_acquire (&inode_sys_lock);
+  rwlock_acquire_read (&inode->rw_lock);
 #endif
   uint32_t length = inode->data.length;
+  size = length - offset > size ? size : length - offset;
+#ifdef PRJ3
+  /* A page some process maps is already in memory. */
+  if (size > 0 && pcache_read (inode->sector, buffer, size, offset))
+  {
 #ifdef PRJ4
-  lock_release (&inode_sys_lock);
+    rwlock_release_read (&inode->rw_lock);
+#endif
+    return size;
+  }
 #endif
-  size = length - offset > size ? size : length - offset;
 #ifdef PRJ4
-  if (offset >= length) return 0;
+  if (offset >= length)
+  {
+    rwlock_release_read (&inode->rw_lock);
+    return 0;
+  }
+#ifndef INDEXED_STRUCTURE
+  if (IS_INLINE (inode->data.info))
+  {
+    memcpy (buffer, INLINE_DATA (&inode->data) + offset, size);
+    rwlock_release_read (&inode->rw_lock);
+    return size;
+  }
+#endif
   // direct_idx와 refer_disk는 indexed structure일 때와
   // linked list structure일 때 구하는 방식이 달라진다.
 #ifdef INDEXED_STRUCTURE
@@ -342,14 +555,9 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   }
 #else
   uint32_t direct_idx = offset / DISK_SECTOR_SIZE % DIRECT_NO;
+  size_t link_idx = offset / (DISK_SECTOR_SIZE * DIRECT_NO);
   struct inode_disk refer_inode_disk;
-  memcpy (&refer_inode_disk, &inode->data, sizeof (struct inode_disk));
-  uint32_t mok;
-  for (mok = offset / (DISK_SECTOR_SIZE * DIRECT_NO);
-        mok > 0;
-        mok--)
-    buffer_cache_read (refer_inode_disk.indirect, &refer_inode_disk,\
-        DISK_SECTOR_SIZE, 0);
+  inode_chain_link (inode, link_idx, &refer_inode_disk);
 #endif
   int sector_ofs = offset % DISK_SECTOR_SIZE;
 #else
@@ -382,6 +590,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (read_bytes <= 0)
         break;
 
+#ifndef INDEXED_STRUCTURE
+      if (sector_idx & SECTOR_UNWRITTEN)
+        memset (buffer + bytes_read, 0, read_bytes);
+      else
+#endif
       buffer_cache_read (sector_idx, buffer + bytes_read, read_bytes, sector_ofs);
       /* zero bytes를 비워줄 수도 있다. */
       sector_ofs = 0;
@@ -401,10 +614,9 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
             &indirect_disk, DISK_SECTOR_SIZE, 0);
       }
 #else
-      if (direct_idx >= DIRECT_NO)
+      if (direct_idx >= DIRECT_NO && size > 0)
       {
-        buffer_cache_read (refer_inode_disk.indirect, \
-            &refer_inode_disk, DISK_SECTOR_SIZE, 0);
+        inode_chain_link (inode, ++link_idx, &refer_inode_disk);
         direct_idx = 0;
       }
 #endif
@@ -447,7 +659,9 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
 #endif
     }
-#ifndef PRJ4
+#ifdef PRJ4
+  rwlock_release_read (&inode->rw_lock);
+#else
   free (bounce);
 #endif
 
@@ -457,23 +671,186 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   A write past end of file extends the inode. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset) 
+{
+  off_t bytes_written;
+#ifdef PRJ3
+  if (is_user_vaddr (buffer))
+    return inode_write_user (inode, buffer, size, offset);
+#endif
+#ifdef PRJ4
+#ifndef INDEXED_STRUCTURE
+  const uint8_t *buf = buffer;
+  off_t length = inode->data.length;
+
+  if (inode->deny_write_cnt)
+    return 0;
+
+  /* A write past end of file first fills the gap with
+     preallocated sectors, which read as zeros.  Then the data
+     goes in INODE_BATCH bytes per journal operation. */
+  if (size > 0 && offset > length
+      && !inode_fallocate (inode, length, offset - length))
+    return 0;
+  bytes_written = 0;
+  while (bytes_written < size)
+  {
+    off_t chunk = size - bytes_written;
+    off_t n;
+
+    if (chunk > INODE_BATCH)
+      chunk = INODE_BATCH;
+    n = inode_write_batch (inode, buf + bytes_written, chunk,
+                           offset + bytes_written);
+    bytes_written += n;
+    if (n != chunk)
+      break;
+  }
+#else
+  bytes_written = inode_write_batch (inode, buffer, size, offset);
+#endif
+#else
+  bytes_written = inode_write_at_locked (inode, buffer, size, offset);
+#ifdef PRJ3
+  pcache_write (inode->sector, buffer, bytes_written, offset);
+#endif
+#endif
+  return bytes_written;
+}
+
+#ifdef PRJ4
+/* Does inode_write_at() as a single journal operation. */
+static off_t
+inode_write_batch (struct inode *inode, const void *buffer, off_t size,
+                   off_t offset)
+{
+  off_t bytes_written;
+  bool extend, meta;
+
+  /* Growing the file, or writing to an inline inode or into a
+     preallocated sector, changes its length or block map, which
+     needs the inode to itself.  Other writes leave both alone
+     and may run alongside readers and other such writers.  The
+     check is safe without the lock: files never shrink, inodes
+     never turn inline again, and sectors preallocated later all
+     lie past the current end of file. */
+  extend = (inode->data.info & INODE_MAP_FLAGS) != 0
+           || offset + size > inode->data.length;
+  meta = extend || inode_is_meta (inode);
+  if (meta)
+    journal_begin ();
+  if (extend)
+    rwlock_acquire_write (&inode->rw_lock);
+  else
+    rwlock_acquire_read (&inode->rw_lock);
+  bytes_written = inode_write_at_locked (inode, buffer, size, offset);
+#ifdef PRJ3
+  pcache_write (inode->sector, buffer, bytes_written, offset);
+#endif
+  if (extend)
+    rwlock_release_write (&inode->rw_lock);
+  else
+    rwlock_release_read (&inode->rw_lock);
+  if (meta)
+    journal_end ();
+  return bytes_written;
+}
+#endif
+
+#ifdef PRJ3
+/* User buffers go through a kernel page a page at a time, so that
+   user memory is never touched while INODE's rw_lock, a buffer
+   cache slot or the page cache lock is held.  Touching it can
+   fault, and the fault handler may need the same locks, for
+   instance if BUFFER is an mmap of this very file. */
+
+/* Does inode_read_at() into user BUFFER. */
+static off_t
+inode_read_user (struct inode *inode, uint8_t *buffer, off_t size,
+                 off_t offset)
+{
+  uint8_t *bounce = palloc_get_page (0);
+  off_t bytes_read = 0;
+
+  if (bounce == NULL)
+    return 0;
+  while (bytes_read < size)
+  {
+    off_t chunk = size - bytes_read < PGSIZE ? size - bytes_read : PGSIZE;
+    off_t n = inode_read_at (inode, bounce, chunk, offset + bytes_read);
+
+    if (n <= 0)
+      break;
+    memcpy (buffer + bytes_read, bounce, n);
+    bytes_read += n;
+    if (n != chunk)
+      break;
+  }
+  palloc_free_page (bounce);
+  return bytes_read;
+}
+
+/* Does inode_write_at() from user BUFFER. */
+static off_t
+inode_write_user (struct inode *inode, const uint8_t *buffer, off_t size,
+                  off_t offset)
+{
+  uint8_t *bounce = palloc_get_page (0);
+  off_t bytes_written = 0;
+
+  if (bounce == NULL)
+    return 0;
+  while (bytes_written < size)
+  {
+    off_t chunk = size - bytes_written < PGSIZE ? size - bytes_written
+                                                 : PGSIZE;
+    off_t n;
+
+    memcpy (bounce, buffer + bytes_written, chunk);
+    n = inode_write_at (inode, bounce, chunk, offset + bytes_written);
+    if (n > 0)
+      bytes_written += n;
+    if (n != chunk)
+      break;
+  }
+  palloc_free_page (bounce);
+  return bytes_written;
+}
+#endif
+
+/* Does the work of inode_write_at().  If the write may extend
+   INODE, the caller must hold INODE's rw_lock for writing,
+   otherwise at least for reading. */
+static off_t
+inode_write_at_locked (struct inode *inode, const void *buffer_, off_t size,
+                       off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
+
+  if (inode->deny_write_cnt)
+    return 0;
+
 #ifdef PRJ4
-  uint32_t info = inode_get_info (inode);
+#ifndef INDEXED_STRUCTURE
+  if (IS_INLINE (inode->data.info) && size > 0)
+  {
+    if ((size_t) (offset + size) <= INODE_INLINE_MAX)
+      return inode_write_inline (inode, buffer, size, offset);
+    if (!inode_convert_inline (inode))
+      return 0;
+  }
+#endif
 #ifdef INDEXED_STRUCTURE
   struct indirect_inode_disk doubly_disk, indirect_disk;
 
   /* try to extend file size */
   if (offset >= inode->data.length && size > 0)
     if (!allocate_inode_disk (offset + size, &inode->data))
-      return -1;
+      return 0;
 
   // refer_idx가 -1이면 inode->data에서 direct대로 찾고
   // 0 이상이면 indirect에서의 indirect가 될 index다.
@@ -498,73 +875,35 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   }
 #else
   struct inode_disk refer_inode_disk;
-  memcpy (&refer_inode_disk, &inode->data, sizeof (struct inode_disk));
-  if (offset >= inode->data.length && size > 0)
+  if (offset + size > inode->data.length && size > 0)
   {
-    lock_acquire (&inode_sys_lock);
-    /* finding refer_previous and start_direct_idx */
-    int start_direct_idx = DIV_ROUND_UP (inode->data.length, DISK_SECTOR_SIZE);
-    disk_sector_t refer_previous_sec_no = inode->data.sector;
-    while (start_direct_idx >= DIRECT_NO)
-    {
-      start_direct_idx -= DIRECT_NO;
-      if (refer_inode_disk.indirect)
-      {
-        refer_previous_sec_no = refer_inode_disk.indirect;
-        buffer_cache_read (refer_inode_disk.indirect, \
-            &refer_inode_disk, DISK_SECTOR_SIZE, 0);
-      }
-    }
-
-    /* 처음 쓰는 거면 새로 refer_previous의 indirect 는 아직
-     * 할당이 안된 상태므로 해준다 */
-    if (start_direct_idx == 0 && inode->data.length > 0)
-    {
-      if (!free_map_allocate (1, &refer_previous_sec_no))
-        return -1;
-      refer_inode_disk.indirect = refer_previous_sec_no;
-      buffer_cache_write (refer_inode_disk.sector,\
-          &refer_inode_disk, DISK_SECTOR_SIZE, 0);
-    }
-
-    /* 총 필요한 direct 갯수 */
-    uint32_t add_sector = bytes_to_sectors (offset + size) - \
-      bytes_to_sectors (inode->data.length);
+    size_t old_sectors = bytes_to_sectors (inode->data.length);
+    size_t new_sectors = bytes_to_sectors (offset + size);
 
-    if (add_sector > 0)
+    if (new_sectors > old_sectors)
     {
-      lock_release (&inode_sys_lock);
-      if (!allocate_inode_disk (add_sector, refer_previous_sec_no, \
-        offset + size, start_direct_idx, info, refer_previous_sec_no, add_sector))
-      {
-        free_map_release (refer_previous_sec_no, 1);
-        return -1;
-      }
-      lock_acquire (&inode_sys_lock);
+      /* Extend from the chain link holding the current last
+         sector. */
+      inode_chain_link (inode,
+          old_sectors == 0 ? 0 : (old_sectors - 1) / DIRECT_NO,
+          &refer_inode_disk);
+      if (!allocate_inode_disk (inode->sector, &refer_inode_disk,
+                                old_sectors, new_sectors, false))
+        return 0;
+      buffer_cache_read (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
     }
-
-    buffer_cache_read(inode->data.sector, &inode->data, DISK_SECTOR_SIZE, 0);
     inode->data.length = offset + size;
-    buffer_cache_write(inode->data.sector, &inode->data, DISK_SECTOR_SIZE, 0);
-    lock_release (&inode_sys_lock);
+    buffer_cache_write_meta (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
   }
-  memcpy (&refer_inode_disk, &inode->data, sizeof (struct inode_disk));
   uint32_t direct_idx = offset / DISK_SECTOR_SIZE % DIRECT_NO;
-  uint32_t mok;
-  for (mok = offset / (DISK_SECTOR_SIZE * DIRECT_NO);
-        mok > 0;
-        mok--)
-    buffer_cache_read (refer_inode_disk.indirect, &refer_inode_disk,\
-        DISK_SECTOR_SIZE, 0);
+  size_t link_idx = offset / (DISK_SECTOR_SIZE * DIRECT_NO);
+  inode_chain_link (inode, link_idx, &refer_inode_disk);
 #endif
   int sector_ofs = offset % DISK_SECTOR_SIZE;
 #else
   uint8_t *bounce = NULL;
 #endif
 
-  if (inode->deny_write_cnt)
-    return 0;
-
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -592,7 +931,17 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (read_bytes <= 0)
         break;
 
-      buffer_cache_write (sector_idx, buffer + bytes_written, read_bytes, sector_ofs);
+#ifndef INDEXED_STRUCTURE
+      if (sector_idx & SECTOR_UNWRITTEN)
+        sector_idx = inode_written (inode, &refer_inode_disk, direct_idx,
+                                    read_bytes < DISK_SECTOR_SIZE);
+#endif
+      if (inode_is_meta (inode))
+        buffer_cache_write_meta (sector_idx, buffer + bytes_written,
+                                 read_bytes, sector_ofs);
+      else
+        buffer_cache_write (sector_idx, buffer + bytes_written, read_bytes,
+                            sector_ofs);
       sector_ofs = 0;
 
       /* Advance. */
@@ -610,10 +959,9 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
             &indirect_disk, DISK_SECTOR_SIZE, 0);
       }
 #else
-      if (direct_idx >= DIRECT_NO)
+      if (direct_idx >= DIRECT_NO && size > 0)
       {
-        buffer_cache_read (refer_inode_disk.indirect, \
-            &refer_inode_disk, DISK_SECTOR_SIZE, 0);
+        inode_chain_link (inode, ++link_idx, &refer_inode_disk);
         direct_idx = 0;
       }
 #endif
@@ -675,8 +1023,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&open_inodes_lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&open_inodes_lock);
 }
 
 /* Re-enables writes to INODE.
@@ -685,9 +1035,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&open_inodes_lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&open_inodes_lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -711,7 +1063,6 @@ allocate_inode_disk (uint32_t new_length, struct inode_disk *inode_disk)
   struct indirect_inode_disk doubly_disk, indirect_disk;
   uint32_t new_alloc_count = 0;
 
-  lock_acquire (&inode_sys_lock);
   uint32_t sectors = bytes_to_sectors (new_length) - \
     bytes_to_sectors (inode_disk->length);
   /* find starting direct_idx to extend */
@@ -723,7 +1074,6 @@ allocate_inode_disk (uint32_t new_length, struct inode_disk *inode_disk)
   {
     if (!free_map_allocate (1, &inode_disk->direct[direct_idx]))
     {
-      lock_release (&inode_sys_lock);
       return false;
     }
     new_alloc_count++;
@@ -736,9 +1086,8 @@ allocate_inode_disk (uint32_t new_length, struct inode_disk *inode_disk)
   /* direct만으로 할당이 끝나면 return */
   if (sectors <= 0)
   {
-    buffer_cache_write (inode_disk->sector,\
+    buffer_cache_write_meta (inode_disk->sector,\
         inode_disk, DISK_SECTOR_SIZE, 0);
-    lock_release (&inode_sys_lock);
     return true;
   }
 
@@ -751,13 +1100,12 @@ allocate_inode_disk (uint32_t new_length, struct inode_disk *inode_disk)
   {
     if (!free_map_allocate (1, &inode_disk->doubly_indirect))
     {
-      lock_release (&inode_sys_lock);
       release_inode_disk (new_alloc_count, inode_disk);
       return false;
     }
-    buffer_cache_write (inode_disk->doubly_indirect, \
+    buffer_cache_write_meta (inode_disk->doubly_indirect, \
         zeros, DISK_SECTOR_SIZE, 0);
-    buffer_cache_write (inode_disk->sector,\
+    buffer_cache_write_meta (inode_disk->sector,\
         inode_disk, DISK_SECTOR_SIZE, 0);
   }
 
@@ -778,7 +1126,6 @@ allocate_inode_disk (uint32_t new_length, struct inode_disk *inode_disk)
   {
     if (!free_map_allocate (1, &indirect_disk.direct[direct_idx]))
     {
-      lock_release (&inode_sys_lock);
       release_inode_disk (new_alloc_count, inode_disk);
       return false;
     }
@@ -789,90 +1136,93 @@ allocate_inode_disk (uint32_t new_length, struct inode_disk *inode_disk)
     sectors--;
     if (direct_idx >= 128 && sectors > 0)
     {
-      buffer_cache_write (doubly_disk.direct[refer_idx], \
+      buffer_cache_write_meta (doubly_disk.direct[refer_idx], \
           &indirect_disk, DISK_SECTOR_SIZE, 0);
       refer_idx++;
       ASSERT (refer_idx < 128);
       direct_idx = 0;
       if (!free_map_allocate (1, &doubly_disk.direct[refer_idx]))
       {
-        lock_release (&inode_sys_lock);
         release_inode_disk (new_alloc_count, inode_disk);
         return false;
       }
-      buffer_cache_write (doubly_disk.direct[refer_idx], \
+      buffer_cache_write_meta (doubly_disk.direct[refer_idx], \
           zeros, DISK_SECTOR_SIZE, 0);
       buffer_cache_read (doubly_disk.direct[refer_idx], \
           &indirect_disk, DISK_SECTOR_SIZE, 0);
     }
   }
 
-  buffer_cache_write (doubly_disk.direct[refer_idx], \
+  buffer_cache_write_meta (doubly_disk.direct[refer_idx], \
       &indirect_disk, DISK_SECTOR_SIZE, 0);
-  buffer_cache_write (inode_disk->doubly_indirect, \
+  buffer_cache_write_meta (inode_disk->doubly_indirect, \
       &doubly_disk, DISK_SECTOR_SIZE, 0);
   inode_disk->length = new_length;
-  lock_release (&inode_sys_lock);
 
   return true;
 }
 #else
-allocate_inode_disk (\
-    uint32_t sectors, \
-    disk_sector_t inode_sector, \
-    off_t length, \
-    int start_direct_idx, \
-    uint32_t info, \
-    uint32_t origin_sector, \
-    uint32_t origin_sectors)
+/* Extends the block map of the inode at HEAD_SECTOR from
+   OLD_SECTORS to NEW_SECTORS data sectors, zeroing each new
+   sector and chaining on links as they fill up.  TAIL must hold
+   a copy of the chain link containing the last of the old
+   sectors (the head itself if there are none); it is clobbered.
+   The inode's length is left for the caller to update.
+
+   If UNWRITTEN is true, the new sectors are not zeroed but
+   marked SECTOR_UNWRITTEN instead, and are taken as a single
+   contiguous run if the free map has one.
+
+   On failure, releases whatever was allocated and returns
+   false. */
+allocate_inode_disk (disk_sector_t head_sector, struct inode_disk *tail,
+                     size_t old_sectors, size_t new_sectors, bool unwritten)
 {
-  struct inode_disk *disk_inode = NULL;
+  size_t slot = old_sectors == 0 ? 0 : (old_sectors - 1) % DIRECT_NO + 1;
+  uint32_t info = tail->info & ~INODE_FLAGS;
+  disk_sector_t sector, run = 0;
+  size_t cnt, run_left = 0;
 
-  /* If this assertion fails, the inode structure is not exactly
-     one sector in size, and you should fix that. */
-  ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
+  if (unwritten && free_map_allocate (new_sectors - old_sectors, &run))
+    run_left = new_sectors - old_sectors;
 
-  disk_inode = calloc (1, sizeof *disk_inode);
-  if (disk_inode == NULL)
+  for (cnt = old_sectors; cnt < new_sectors; cnt++)
   {
-    release_inode_disk (origin_sector - sectors, origin_sector);
-    return false;
-  }
-  lock_acquire (&inode_sys_lock);
-  buffer_cache_read (inode_sector, disk_inode, DISK_SECTOR_SIZE, 0);
-
-  disk_inode->length = length;
-  disk_inode->sector = inode_sector;
-  disk_inode->info = info;
-  disk_inode->magic = INODE_MAGIC;
-  int direct_alloc_num = sectors + start_direct_idx > DIRECT_NO ? \
-                         DIRECT_NO : start_direct_idx + sectors;
-  int i;
-  for (i = start_direct_idx; i < direct_alloc_num; i++)
-  {
-    free_map_allocate (1, &disk_inode->direct[i]);
-    buffer_cache_write (disk_inode->direct[i], zeros, DISK_SECTOR_SIZE, 0);
-  }
-
-  if (sectors - i + start_direct_idx > 0)
-  {
-    disk_sector_t new_indirect_sector;
-    free_map_allocate (1, &new_indirect_sector);
-    disk_inode->indirect = new_indirect_sector;
-    buffer_cache_write (inode_sector, disk_inode, DISK_SECTOR_SIZE, 0);
-    free (disk_inode);
-    lock_release (&inode_sys_lock);
-    return allocate_inode_disk (sectors - i + start_direct_idx, \
-        new_indirect_sector, length, 0, info, origin_sector, origin_sectors);
-  }
-  else
-  {
-    buffer_cache_write (inode_sector, disk_inode, DISK_SECTOR_SIZE, 0);
-    free (disk_inode);
-    lock_release (&inode_sys_lock);
+    if (slot == DIRECT_NO)
+    {
+      /* This link is full, so start a fresh one after it. */
+      if (!free_map_allocate (1, &sector))
+        goto fail;
+      tail->indirect = sector;
+      buffer_cache_write_meta (tail->sector, tail, DISK_SECTOR_SIZE, 0);
+      memset (tail, 0, sizeof *tail);
+      tail->sector = sector;
+      tail->info = info;
+      tail->magic = INODE_MAGIC;
+      slot = 0;
+    }
+    if (run_left > 0)
+    {
+      sector = run++;
+      run_left--;
+    }
+    else if (!free_map_allocate (1, &sector))
+      goto fail;
+    if (unwritten)
+      sector |= SECTOR_UNWRITTEN;
+    else
+      buffer_cache_write (sector, zeros, DISK_SECTOR_SIZE, 0);
+    tail->direct[slot++] = sector;
   }
-
+  buffer_cache_write_meta (tail->sector, tail, DISK_SECTOR_SIZE, 0);
   return true;
+
+fail:
+  buffer_cache_write_meta (tail->sector, tail, DISK_SECTOR_SIZE, 0);
+  release_chain (head_sector, old_sectors, cnt);
+  if (run_left > 0)
+    free_map_release (run, run_left);
+  return false;
 }
 #endif
 
@@ -882,7 +1232,6 @@ release_inode_disk (uint32_t sectors, struct inode_disk *inode_disk)
 {
   struct indirect_inode_disk doubly_disk, indirect_disk;
 
-  lock_acquire (&inode_sys_lock);
   uint32_t new_length = inode_disk->length;
   uint32_t next_shrink_size = new_length % DISK_SECTOR_SIZE;
   if (!next_shrink_size) next_shrink_size = DISK_SECTOR_SIZE;
@@ -944,9 +1293,21 @@ release_inode_disk (uint32_t sectors, struct inode_disk *inode_disk)
     free_map_release (inode_disk->sector, 1);
   else
     inode_disk->length = new_length;
-  lock_release (&inode_sys_lock);
+}
+
+/* Writes every dirty data sector in the buffer cache back to
+   disk.  Walking the indexed block map just for this is not
+   worth it. */
+void
+inode_sync (struct inode *inode UNUSED)
+{
+  buffer_cache_write_back ();
 }
 #else
+/* Releases the SECTORS data sectors of the inode at
+   INODE_SECTOR, along with every chain link but the head.  Works
+   from the end of the file back, INODE_BATCH bytes per journal
+   operation. */
 release_inode_disk (uint32_t sectors, disk_sector_t inode_sector)
 {
   struct inode_disk *disk_inode = NULL;
@@ -954,47 +1315,511 @@ release_inode_disk (uint32_t sectors, disk_sector_t inode_sector)
   /* If this assertion fails, the inode structure is not exactly
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
-  disk_inode = calloc (1, sizeof *disk_inode);
-
-  lock_acquire (&inode_sys_lock);
+  disk_inode = malloc (sizeof *disk_inode);
+  if (disk_inode == NULL)
+    return;
   buffer_cache_read (inode_sector, disk_inode, DISK_SECTOR_SIZE, 0);
 
-  int direct_alloc_num = sectors > DIRECT_NO ? DIRECT_NO : sectors;
-  int i;
+  /* Inline inodes own no sectors besides their own. */
+  if (!IS_INLINE (disk_inode->info))
+    while (sectors > 0)
+    {
+      size_t batch = INODE_BATCH / DISK_SECTOR_SIZE;
+      size_t from = sectors > batch
+                    ? (sectors - batch) / DIRECT_NO * DIRECT_NO : 0;
+
+      journal_begin ();
+      release_chain (inode_sector, from, sectors);
+      journal_end ();
+      sectors = from;
+    }
+  free (disk_inode);
+}
+
+/* Releases data sectors FROM up to TO of the inode at
+   HEAD_SECTOR, and each chain link past the head that holds
+   none of the sectors before FROM.  Walks the chain in a loop
+   rather than recursing, so a long file cannot run the kernel
+   stack out. */
+static void
+release_chain (disk_sector_t head_sector, size_t from, size_t to)
+{
+  struct inode_disk *link = malloc (sizeof *link);
+  size_t first;                 /* Index of link->direct[0]. */
 
-  if (sectors - direct_alloc_num > 0)
+  if (link == NULL)
+    return;
+  buffer_cache_read (head_sector, link, DISK_SECTOR_SIZE, 0);
+  for (first = 0; first < to; first += DIRECT_NO)
   {
-    lock_release (&inode_sys_lock);
-    release_inode_disk (sectors - direct_alloc_num, disk_inode->indirect);
-    lock_acquire (&inode_sys_lock);
-    free_map_release (disk_inode->indirect, 1);
-    buffer_cache_release (disk_inode->indirect);
-    /* ??? */
+    disk_sector_t next = link->indirect;
+    size_t i;
+
+    for (i = 0; i < DIRECT_NO && first + i < to; i++)
+      if (first + i >= from)
+      {
+        disk_sector_t sector = SECTOR_NO (link->direct[i]);
+        free_map_release (sector, 1);
+        buffer_cache_release (sector);
+      }
+    if (first > 0 && first >= from)
+    {
+      free_map_release (link->sector, 1);
+      buffer_cache_release (link->sector);
+    }
+    if (first + DIRECT_NO < to)
+      buffer_cache_read (next, link, DISK_SECTOR_SIZE, 0);
   }
+  free (link);
+}
+
+/* Copies chain link LINK_IDX of INODE's block map into LINK.
+   The last link looked up is remembered, so sequential access
+   and repeated hits on one region read a single link instead of
+   walking the chain from the head.  INODE's rw_lock must be held,
+   which keeps the chain from changing under us. */
+static void
+inode_chain_link (struct inode *inode, size_t link_idx,
+                  struct inode_disk *link)
+{
+  size_t idx;
+  disk_sector_t sector;
+
+  lock_acquire (&inode->cursor_lock);
+  idx = inode->cursor_idx;
+  sector = inode->cursor_sector;
+  lock_release (&inode->cursor_lock);
 
-  for (i = 0; i < direct_alloc_num; i++)
+  if (idx == 0 || idx > link_idx)
   {
-    free_map_release (disk_inode->direct[i], 1);
-    buffer_cache_release (disk_inode->direct[i]);
+    memcpy (link, &inode->data, sizeof *link);
+    idx = 0;
   }
+  else
+    buffer_cache_read (sector, link, DISK_SECTOR_SIZE, 0);
+  for (; idx < link_idx; idx++)
+    buffer_cache_read (link->indirect, link, DISK_SECTOR_SIZE, 0);
+
+  lock_acquire (&inode->cursor_lock);
+  inode->cursor_idx = link_idx;
+  inode->cursor_sector = link->sector;
+  lock_release (&inode->cursor_lock);
+}
+
+/* Writes an inline inode of LENGTH bytes, all zero, to SECTOR. */
+static bool
+inode_create_inline (disk_sector_t sector, off_t length, uint32_t info)
+{
+  struct inode_disk *disk_inode = NULL;
 
+  ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
+  disk_inode = calloc (1, sizeof *disk_inode);
+  if (disk_inode == NULL)
+    return false;
+
+  disk_inode->sector = sector;
+  disk_inode->info = info | INODE_INLINE;
+  disk_inode->length = length;
+  disk_inode->magic = INODE_MAGIC;
+  buffer_cache_write_meta (sector, disk_inode, DISK_SECTOR_SIZE, 0);
   free (disk_inode);
-  lock_release (&inode_sys_lock);
+  super_add_inodes (1);
+  return true;
+}
+
+/* Writes SIZE bytes from BUFFER into inline INODE at OFFSET.
+   The write must end within INODE_INLINE_MAX bytes. */
+static off_t
+inode_write_inline (struct inode *inode, const void *buffer, off_t size,
+                    off_t offset)
+{
+  ASSERT ((size_t) (offset + size) <= INODE_INLINE_MAX);
+
+  memcpy (INLINE_DATA (&inode->data) + offset, buffer, size);
+  if (offset + size > inode->data.length)
+    inode->data.length = offset + size;
+  buffer_cache_write_meta (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
+  return size;
+}
+
+/* Moves the content of inline INODE out into a data sector and
+   turns INODE into an ordinary block-mapped inode. */
+static bool
+inode_convert_inline (struct inode *inode)
+{
+  off_t length = inode->data.length;
+  uint8_t *saved = malloc (INODE_INLINE_MAX);
+  if (saved == NULL)
+    return false;
+
+  memcpy (saved, INLINE_DATA (&inode->data), length);
+  memset (inode->data.direct, 0, sizeof inode->data.direct);
+  inode->data.indirect = 0;
+  inode->data.info &= ~INODE_INLINE;
+  inode->data.length = 0;
+  buffer_cache_write_meta (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
+
+  if (length > 0)
+  {
+    if (!allocate_inode_disk (inode->sector, &inode->data, 0, 1, false))
+    {
+      buffer_cache_read (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
+      free (saved);
+      return false;
+    }
+    buffer_cache_read (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
+    inode->data.length = length;
+    buffer_cache_write_meta (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
+    if (inode_is_meta (inode))
+      buffer_cache_write_meta (inode->data.direct[0], saved, length, 0);
+    else
+      buffer_cache_write (inode->data.direct[0], saved, length, 0);
+  }
+  free (saved);
+  return true;
+}
+
+/* Marks entry DIRECT_IDX of chain link LINK, a copy of one of
+   INODE's links, as written and returns its sector.  If the
+   caller is about to write only PARTIAL sector, zeros it first so
+   the rest of the sector does not expose stale data.  INODE's
+   rw_lock must be held for writing. */
+static disk_sector_t
+inode_written (struct inode *inode, struct inode_disk *link,
+               size_t direct_idx, bool partial)
+{
+  disk_sector_t sector = SECTOR_NO (link->direct[direct_idx]);
+
+  if (partial)
+    buffer_cache_write (sector, zeros, DISK_SECTOR_SIZE, 0);
+  link->direct[direct_idx] = sector;
+  if (link->sector == inode->sector)
+    inode->data.direct[direct_idx] = sector;
+  buffer_cache_write_meta (link->sector, link, DISK_SECTOR_SIZE, 0);
+  return sector;
+}
+
+/* Makes sure INODE has sectors behind the LEN bytes starting at
+   OFFSET, extending it to OFFSET + LEN bytes if it is shorter.
+   The new sectors are taken as one contiguous run when possible
+   and are not written: they are marked unwritten and read as
+   zeros until data is written to them.
+   INODE grows by at most INODE_BATCH bytes per journal operation.
+   Returns true if successful, false on bad arguments or if the
+   disk is full, in which case INODE keeps whatever the earlier
+   operations added. */
+bool
+inode_fallocate (struct inode *inode, off_t offset, off_t len)
+{
+  off_t end = offset + len;
+  bool success, done;
+
+  if (offset < 0 || len <= 0 || end < offset)
+    return false;
+
+  do
+  {
+    journal_begin ();
+    rwlock_acquire_write (&inode->rw_lock);
+    success = inode_fallocate_batch (inode, end, &done);
+    rwlock_release_write (&inode->rw_lock);
+    journal_end ();
+  }
+  while (success && !done);
+  return success;
+}
+
+/* Does one journal operation's worth of inode_fallocate(),
+   extending INODE toward END by at most INODE_BATCH bytes.  Sets
+   *DONE to false if INODE still falls short of END afterward.
+   INODE's rw_lock must be held for writing. */
+static bool
+inode_fallocate_batch (struct inode *inode, off_t end, bool *done)
+{
+  *done = true;
+  if (inode->deny_write_cnt)
+    return false;
+  if (end <= inode->data.length)
+    return true;
+  if (IS_INLINE (inode->data.info))
+  {
+    if ((size_t) end <= INODE_INLINE_MAX)
+    {
+      /* Bytes past the end of an inline inode are already zero. */
+      inode->data.length = end;
+      buffer_cache_write_meta (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
+      return true;
+    }
+    if (!inode_convert_inline (inode))
+      return false;
+  }
+  if (end - inode->data.length > INODE_BATCH)
+  {
+    end = inode->data.length + INODE_BATCH;
+    *done = false;
+  }
+  return inode_extend (inode, end, true);
+}
+
+/* Extends block-mapped INODE to END bytes, allocating all of the
+   new sectors in one go, and marks them unwritten if UNWRITTEN
+   is true.  INODE's rw_lock must be held for writing.  Returns
+   true if successful, false if the disk is full, in which case
+   INODE is unchanged. */
+static bool
+inode_extend (struct inode *inode, off_t end, bool unwritten)
+{
+  size_t old_sectors = bytes_to_sectors (inode->data.length);
+  size_t new_sectors = bytes_to_sectors (end);
+
+  if (new_sectors > old_sectors)
+  {
+    struct inode_disk *tail = malloc (sizeof *tail);
+    bool success;
+
+    if (tail == NULL)
+      return false;
+    inode_chain_link (inode,
+        old_sectors == 0 ? 0 : (old_sectors - 1) / DIRECT_NO, tail);
+    success = allocate_inode_disk (inode->sector, tail,
+                                   old_sectors, new_sectors, unwritten);
+    free (tail);
+    if (!success)
+      return false;
+    buffer_cache_read (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
+    if (unwritten)
+      inode->data.info |= INODE_UNWRITTEN;
+  }
+  inode->data.length = end;
+  buffer_cache_write_meta (inode->sector, &inode->data, DISK_SECTOR_SIZE, 0);
+  return true;
+}
+
+/* Copies SIZE bytes at SRC_OFS in SRC to DST_OFS in DST,
+   extending DST if needed.  Returns the number of bytes copied,
+   which is less than SIZE if SRC ends first, or -1 if DST cannot
+   be extended.  The data goes from cache slot to cache slot
+   without a bounce buffer, and whatever DST needs past its end
+   is allocated up front as one run, like inode_fallocate() does,
+   instead of a sector per write.  Like inode_write_at(), copies
+   INODE_BATCH bytes per journal operation. */
+off_t
+inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src,
+            off_t src_ofs, off_t size)
+{
+  struct inode_disk *s_link, *d_link;
+  off_t copied = 0, length;
+
+  if (size <= 0 || src_ofs < 0 || dst_ofs < 0)
+    return 0;
+
+  /* Inline inodes have no sectors to copy between, and a copy
+     within one file would need its block map twice at once.
+     Neither is common enough to be worth more than a bounce
+     through a kernel buffer.  The checks are safe without the
+     locks because inodes never turn inline again. */
+  if (dst == src || IS_INLINE (src->data.info) || IS_INLINE (dst->data.info))
+    return inode_copy_bounce (dst, dst_ofs, src, src_ofs, size);
+#ifdef PRJ3
+  /* Copying cache slot to cache slot would leave DST's pages in
+     the page cache stale; inode_write_at() keeps them current. */
+  if (pcache_cached (dst->sector))
+    return inode_copy_bounce (dst, dst_ofs, src, src_ofs, size);
+#endif
+
+  s_link = malloc (sizeof *s_link);
+  d_link = malloc (sizeof *d_link);
+  if (s_link == NULL || d_link == NULL)
+  {
+    free (s_link);
+    free (d_link);
+    return inode_copy_bounce (dst, dst_ofs, src, src_ofs, size);
+  }
+
+  /* Fill any gap before DST_OFS the way inode_write_at() does.
+     The checks are safe without the locks because files never
+     shrink. */
+  length = dst->data.length;
+  if (dst_ofs > length && src_ofs < src->data.length
+      && !inode_fallocate (dst, length, dst_ofs - length))
+    copied = -1;
+  while (copied >= 0 && copied < size)
+  {
+    off_t chunk = size - copied;
+    off_t n;
+
+    if (chunk > INODE_BATCH)
+      chunk = INODE_BATCH;
+    n = inode_copy_batch (dst, dst_ofs + copied, src, src_ofs + copied,
+                          chunk, s_link, d_link);
+    if (n < 0)
+    {
+      if (copied == 0)
+        copied = -1;
+      break;
+    }
+    copied += n;
+    if (n != chunk)
+      break;
+  }
+  free (s_link);
+  free (d_link);
+  return copied;
+}
+
+/* Does inode_copy() as a single journal operation, using S_LINK
+   and D_LINK to hold chain links. */
+static off_t
+inode_copy_batch (struct inode *dst, off_t dst_ofs, struct inode *src,
+                  off_t src_ofs, off_t size, struct inode_disk *s_link,
+                  struct inode_disk *d_link)
+{
+  size_t s_link_idx = SIZE_MAX, d_link_idx = SIZE_MAX;
+  off_t copied = 0;
+
+  journal_begin ();
+  /* Take the two locks in sector order, so that copies in
+     opposite directions cannot deadlock. */
+  if (src->sector < dst->sector)
+    rwlock_acquire_read (&src->rw_lock);
+  rwlock_acquire_write (&dst->rw_lock);
+  if (src->sector > dst->sector)
+    rwlock_acquire_read (&src->rw_lock);
+
+  if (dst->deny_write_cnt || src_ofs >= src->data.length)
+    goto done;
+  if (size > src->data.length - src_ofs)
+    size = src->data.length - src_ofs;
+  if (dst_ofs + size > dst->data.length
+      && !inode_extend (dst, dst_ofs + size, true))
+  {
+    copied = -1;
+    goto done;
+  }
+
+  while (copied < size)
+  {
+    off_t s_pos = src_ofs + copied, d_pos = dst_ofs + copied;
+    size_t s_idx = s_pos / DISK_SECTOR_SIZE, d_idx = d_pos / DISK_SECTOR_SIZE;
+    off_t s_ofs = s_pos % DISK_SECTOR_SIZE, d_ofs = d_pos % DISK_SECTOR_SIZE;
+    off_t chunk = DISK_SECTOR_SIZE - (s_ofs > d_ofs ? s_ofs : d_ofs);
+    disk_sector_t s_sector, d_sector;
+
+    if (chunk > size - copied)
+      chunk = size - copied;
+    if (s_idx / DIRECT_NO != s_link_idx)
+    {
+      s_link_idx = s_idx / DIRECT_NO;
+      inode_chain_link (src, s_link_idx, s_link);
+    }
+    if (d_idx / DIRECT_NO != d_link_idx)
+    {
+      d_link_idx = d_idx / DIRECT_NO;
+      inode_chain_link (dst, d_link_idx, d_link);
+    }
+
+    s_sector = s_link->direct[s_idx % DIRECT_NO];
+    d_sector = d_link->direct[d_idx % DIRECT_NO];
+    if (d_sector & SECTOR_UNWRITTEN)
+      d_sector = inode_written (dst, d_link, d_idx % DIRECT_NO,
+                                chunk < DISK_SECTOR_SIZE);
+    if (s_sector & SECTOR_UNWRITTEN)
+      buffer_cache_write (d_sector, zeros, chunk, d_ofs);
+    else
+      buffer_cache_copy (d_sector, d_ofs, s_sector, s_ofs, chunk);
+    copied += chunk;
+  }
+
+ done:
+  rwlock_release_write (&dst->rw_lock);
+  rwlock_release_read (&src->rw_lock);
+  journal_end ();
+  return copied;
+}
+
+/* Does inode_copy() by reading into and writing from a kernel
+   buffer a sector at a time. */
+static off_t
+inode_copy_bounce (struct inode *dst, off_t dst_ofs, struct inode *src,
+                   off_t src_ofs, off_t size)
+{
+  uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
+  off_t copied = 0;
+
+  if (bounce == NULL)
+    return -1;
+  while (copied < size)
+  {
+    off_t chunk = size - copied < DISK_SECTOR_SIZE ? size - copied
+                                                   : DISK_SECTOR_SIZE;
+    off_t bytes_read = inode_read_at (src, bounce, chunk, src_ofs + copied);
+    off_t bytes_written;
+
+    if (bytes_read <= 0)
+      break;
+    bytes_written = inode_write_at (dst, bounce, bytes_read, dst_ofs + copied);
+    if (bytes_written > 0)
+      copied += bytes_written;
+    if (bytes_written != bytes_read)
+      break;
+  }
+  free (bounce);
+  return copied;
+}
+
+/* Writes every data sector INODE owns back to disk, if it is
+   dirty in the buffer cache.  The inode itself and its chain
+   links are metadata, which only the journal writes.
+   Preallocated sectors that were never written hold nothing to
+   save. */
+void
+inode_sync (struct inode *inode)
+{
+  struct inode_disk *link;
+  size_t sectors, first, i;
+
+  rwlock_acquire_read (&inode->rw_lock);
+  if (IS_INLINE (inode->data.info))
+    goto done;
+
+  link = malloc (sizeof *link);
+  if (link == NULL)
+  {
+    buffer_cache_write_back ();
+    goto done;
+  }
+  memcpy (link, &inode->data, sizeof *link);
+  sectors = bytes_to_sectors (inode->data.length);
+  for (first = 0; first < sectors; first += DIRECT_NO)
+  {
+    for (i = 0; i < DIRECT_NO && first + i < sectors; i++)
+      if (!(link->direct[i] & SECTOR_UNWRITTEN))
+        buffer_cache_flush (link->direct[i]);
+    if (first + DIRECT_NO < sectors)
+      buffer_cache_read (link->indirect, link, DISK_SECTOR_SIZE, 0);
+  }
+  free (link);
+
+ done:
+  rwlock_release_read (&inode->rw_lock);
 }
 
 void
 print_all_inodes (void)
 {
-  printf ("total openlist : %d\n", list_size (&open_inodes));
-  struct inode * i = NULL;
-  struct list_elem *elem_pointer = list_begin (&open_inodes);
-  while (elem_pointer != list_end (&open_inodes))
+  struct hash_iterator it;
+  struct inode *i;
+
+  lock_acquire (&open_inodes_lock);
+  printf ("total openlist : %d\n", hash_size (&open_inodes));
+  hash_first (&it, &open_inodes);
+  while (hash_next (&it))
   {
-    i = list_entry (elem_pointer, struct inode, elem);
+    i = hash_entry (hash_cur (&it), struct inode, elem);
     printf ("inode : %d , open_cnt : %d\n",\
         i->sector, i->open_cnt);
-    elem_pointer = list_next (elem_pointer);
   }
+  lock_release (&open_inodes_lock);
 }
 #endif
 #endif
@@ -25,24 +25,37 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+bool inode_is_removed (const struct inode *);
+void inode_lock_dir (struct inode *, bool exclusive);
+void inode_unlock_dir (struct inode *, bool exclusive);
 
 #ifdef PRJ4
 #include "filesys/cache.h"
+
+/* Info flag of a directory whose entries are variable-length
+   records rather than fixed-size slots.  See directory.c. */
+#define INODE_DIR_COMPACT 0x20000000
+
+/* Info flag of a directory's hash index.  Its contents are
+   metadata, like the directory's.  See directory.c. */
+#define INODE_DIR_INDEX 0x10000000
+
 #ifdef INDEXED_STRUCTURE
 bool allocate_inode_disk (uint32_t, struct inode_disk*);
 void release_inode_disk (uint32_t, struct inode_disk*);
 #else
-bool allocate_inode_disk (uint32_t sectors, disk_sector_t inode_sector, off_t length, int add_direct_idx, uint32_t info, disk_sector_t origin_sector, uint32_t origin_sectors);
+bool allocate_inode_disk (disk_sector_t head_sector, struct inode_disk *tail, size_t old_sectors, size_t new_sectors, bool unwritten);
+bool inode_fallocate (struct inode *, off_t offset, off_t len);
+off_t inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src, off_t src_ofs, off_t size);
 void release_inode_disk (uint32_t sectors, disk_sector_t inode_sector);
 #endif
+void inode_sync (struct inode *);
 int inode_open_cnt (struct inode *);
 void print_all_inodes (void);
 uint32_t inode_get_info (struct inode *);
 bool inode_is_directory (struct inode *);
 uint32_t inode_get_level (struct inode *);
 uint32_t inode_set_level (uint32_t, uint32_t);
-void inode_lock_acquire (void);
-void inode_lock_release (void);
 #endif
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,224 @@
+#include "filesys/journal.h"
+#ifdef PRJ4
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/super.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Metadata journal.
+
+   Inodes, chain links, directories and the free map are
+   metadata.  The buffer cache keeps dirty metadata from reaching
+   its own sectors, and journal_commit() writes all of it at
+   once: first to the log right after the commit record, then
+   the commit record naming where each logged sector belongs,
+   then each sector in place, and last an empty commit record.
+   A crash before the commit record is written loses the whole
+   group; a crash after it is repaired by replaying the log at
+   the next boot.
+
+   File system operations that change metadata run between
+   journal_begin() and journal_end(), which may nest.  A commit
+   waits for running operations to end and holds off new ones,
+   so a group holds only whole operations.  The write-back
+   thread commits a group every WRITE_BACK_PERIOD, and
+   journal_begin() commits one early once the cache fills up
+   with metadata.  An operation must leave room for the rest of
+   the cache, so large writes, preallocations and releases are
+   split into operations of bounded size (see INODE_BATCH). */
+
+#define JOURNAL_MAGIC 0x4a524e4c        /* "JRNL" */
+
+/* Number of cache slots holding metadata that makes
+   journal_begin() commit before starting an operation. */
+#define JOURNAL_THRESHOLD (BUFFER_CACHE_SIZE / 2)
+
+/* If true, journal_done() stops its commit right after writing
+   the commit record, as if the machine crashed there, so that
+   the next boot has to replay the log.  Set by the
+   "-journal-crash" kernel command line option for testing. */
+bool journal_crash;
+
+/* Commit record.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_record
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t cnt;                       /* Sectors in the log, or 0. */
+    disk_sector_t sectors[JOURNAL_BLOCKS]; /* Where each one belongs. */
+    uint8_t unused[DISK_SECTOR_SIZE - 2 * sizeof (uint32_t)
+                   - JOURNAL_BLOCKS * sizeof (disk_sector_t)];
+  };
+
+static struct lock journal_lock;        /* Guards the members below. */
+static struct condition no_updates;     /* Signaled when updates drops to 0. */
+static struct condition commit_done;    /* Signaled when a commit ends. */
+static int updates;                     /* Operations in progress. */
+static struct thread *committer;        /* Thread committing, if any. */
+
+static bool journal_ready;              /* Set once the log is usable. */
+static bool crashing;                   /* Stop the last commit early? */
+static struct journal_record record;    /* Owned by the committer. */
+
+static void write_record (uint32_t cnt);
+static void journal_replay (void);
+
+/* Initializes the journal, replaying any group that was
+   committed but not yet written in place.  If FORMAT is true,
+   writes an empty journal instead. */
+void
+journal_init (bool format)
+{
+  ASSERT (sizeof record == DISK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  cond_init (&no_updates);
+  cond_init (&commit_done);
+  if (format)
+    write_record (0);
+  else
+    journal_replay ();
+  journal_ready = true;
+}
+
+/* Commits the last group before the file system shuts down. */
+void
+journal_done (void)
+{
+  crashing = journal_crash;
+  journal_commit ();
+  journal_ready = false;
+}
+
+/* Starts a file system operation that changes metadata. */
+void
+journal_begin (void)
+{
+  struct thread *t = thread_current ();
+
+  /* The committer's own updates, such as releasing the sectors
+     freed in the group, go into the group it is committing. */
+  if (t->journal_depth++ > 0 || t == committer)
+    return;
+
+  if (journal_ready && buffer_cache_meta_cnt () >= JOURNAL_THRESHOLD)
+  {
+    t->journal_depth--;
+    journal_commit ();
+    t->journal_depth++;
+  }
+
+  lock_acquire (&journal_lock);
+  while (committer != NULL)
+    cond_wait (&commit_done, &journal_lock);
+  updates++;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation started by journal_begin(). */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0 || t == committer)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (--updates == 0)
+    cond_broadcast (&no_updates, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Commits every operation that has ended so far and writes the
+   file system's data back to disk.  Must not be called between
+   journal_begin() and journal_end(). */
+void
+journal_commit (void)
+{
+  size_t cnt;
+
+  ASSERT (thread_current ()->journal_depth == 0);
+  if (!journal_ready)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (committer != NULL)
+  {
+    /* That commit waits for whatever we did too. */
+    while (committer != NULL)
+      cond_wait (&commit_done, &journal_lock);
+    lock_release (&journal_lock);
+    return;
+  }
+  committer = thread_current ();
+  while (updates > 0)
+    cond_wait (&no_updates, &journal_lock);
+  lock_release (&journal_lock);
+
+  /* Sectors freed in the group could not be reused inside it,
+     because the last commit still points at them. */
+  free_map_commit ();
+  super_commit ();
+
+  /* Data goes first, so that committed metadata never points at
+     sectors whose contents are only in the cache. */
+  buffer_cache_write_back ();
+  cnt = buffer_cache_log (JOURNAL_SECTOR + 1, record.sectors, JOURNAL_BLOCKS);
+  if (cnt > 0)
+  {
+    write_record (cnt);
+    if (crashing)
+      printf ("journal: stopping after commit record.\n");
+    else
+    {
+      buffer_cache_checkpoint ();
+      write_record (0);
+    }
+  }
+
+  lock_acquire (&journal_lock);
+  committer = NULL;
+  cond_broadcast (&commit_done, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Writes the commit record, saying that the log holds CNT
+   sectors. */
+static void
+write_record (uint32_t cnt)
+{
+  record.magic = JOURNAL_MAGIC;
+  record.cnt = cnt;
+  disk_write (filesys_disk, JOURNAL_SECTOR, &record);
+}
+
+/* Writes each sector in a committed log to where it belongs. */
+static void
+journal_replay (void)
+{
+  static uint8_t bounce[DISK_SECTOR_SIZE];
+  uint32_t i;
+
+  disk_read (filesys_disk, JOURNAL_SECTOR, &record);
+  if (record.magic != JOURNAL_MAGIC)
+    PANIC ("file system has no journal, reformat it with -f");
+  if (record.cnt == 0)
+    return;
+  if (record.cnt > JOURNAL_BLOCKS)
+    PANIC ("journal commit record is corrupt");
+
+  for (i = 0; i < record.cnt; i++)
+  {
+    disk_read (filesys_disk, JOURNAL_SECTOR + 1 + i, bounce);
+    disk_write (filesys_disk, record.sectors[i], bounce);
+  }
+  printf ("journal: replayed %"PRIu32" sectors.\n", record.cnt);
+  write_record (0);
+}
+#endif
@@ -0,0 +1,24 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+#ifdef PRJ4
+#include <stdbool.h>
+#include "devices/disk.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+
+/* The journal takes up JOURNAL_SECTORS sectors from
+   JOURNAL_SECTOR on: a commit record, then room for every sector
+   the buffer cache can hold. */
+#define JOURNAL_SECTOR (SUPERBLOCK_SECTOR + 1)
+#define JOURNAL_BLOCKS BUFFER_CACHE_SIZE
+#define JOURNAL_SECTORS (1 + JOURNAL_BLOCKS)
+
+extern bool journal_crash;
+
+void journal_init (bool format);
+void journal_done (void);
+void journal_begin (void);
+void journal_end (void);
+void journal_commit (void);
+#endif
+#endif /* filesys/journal.h */
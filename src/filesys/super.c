@@ -0,0 +1,181 @@
+#include "filesys/super.h"
+#ifdef PRJ4
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+
+/* Superblock.
+
+   Keeps the counts that would otherwise take a scan of the free
+   map or of every inode: free sectors, in all and per group, and
+   inodes in use.  It is metadata like the free map it
+   summarizes, so the journal commits the two together and the
+   counts stay right across a crash.
+
+   The clean flag is cleared on disk for as long as the file
+   system is mounted.  A mount that finds it cleared recounts
+   free sectors from the free map instead of trusting the
+   counts; one that finds it set reads nothing else up front. */
+
+#define SUPER_MAGIC 0x53555052          /* "SUPR" */
+#define SUPER_VERSION 1                 /* On-disk format version. */
+#define SUPER_GROUPS_MAX 240            /* Groups a superblock can track. */
+
+/* On-disk superblock.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct superblock
+  {
+    unsigned magic;                     /* SUPER_MAGIC. */
+    uint32_t version;                   /* SUPER_VERSION. */
+    uint32_t clean;                     /* 1 if unmounted cleanly. */
+    uint32_t sector_cnt;                /* Sectors on the disk. */
+    uint32_t free_cnt;                  /* Free sectors. */
+    uint32_t inode_cnt;                 /* Inodes in use. */
+    uint32_t group_cnt;                 /* Groups on the disk. */
+    uint16_t group_free[SUPER_GROUPS_MAX]; /* Free sectors per group. */
+    uint8_t unused[DISK_SECTOR_SIZE - 7 * sizeof (uint32_t)
+                   - SUPER_GROUPS_MAX * sizeof (uint16_t)];
+  };
+
+static struct superblock sb;
+static struct lock super_lock;          /* Guards sb and sb_dirty. */
+static bool sb_dirty;                   /* Changed since super_commit()? */
+static bool was_clean;                  /* Clean flag found at mount. */
+
+/* Reads the superblock, or writes a new one if FORMAT is true,
+   and marks the file system as mounted. */
+void
+super_init (bool format)
+{
+  size_t g;
+
+  ASSERT (sizeof sb == DISK_SECTOR_SIZE);
+  lock_init (&super_lock);
+
+  if (format)
+  {
+    memset (&sb, 0, sizeof sb);
+    sb.magic = SUPER_MAGIC;
+    sb.version = SUPER_VERSION;
+    sb.sector_cnt = disk_size (filesys_disk);
+    sb.free_cnt = sb.sector_cnt;
+    sb.group_cnt = DIV_ROUND_UP (sb.sector_cnt, SUPER_GROUP_SECTORS);
+    if (sb.group_cnt > SUPER_GROUPS_MAX)
+      PANIC ("disk is too large for the superblock");
+    for (g = 0; g < sb.group_cnt; g++)
+      sb.group_free[g] = (g + 1 < sb.group_cnt
+                          ? SUPER_GROUP_SECTORS
+                          : sb.sector_cnt - g * SUPER_GROUP_SECTORS);
+    was_clean = true;
+  }
+  else
+  {
+    disk_read (filesys_disk, SUPERBLOCK_SECTOR, &sb);
+    if (sb.magic != SUPER_MAGIC)
+      PANIC ("file system has no superblock, reformat it with -f");
+    if (sb.version != SUPER_VERSION)
+      PANIC ("file system version %"PRIu32" is not supported, "
+             "reformat it with -f", sb.version);
+    if (sb.sector_cnt != disk_size (filesys_disk))
+      PANIC ("superblock does not match the disk size");
+    was_clean = sb.clean != 0;
+  }
+
+  /* Written in place right away, so that a crash from here on
+     is noticed at the next mount. */
+  sb.clean = 0;
+  disk_write (filesys_disk, SUPERBLOCK_SECTOR, &sb);
+}
+
+/* Marks the file system as unmounted cleanly.  The next
+   super_commit() writes the flag out. */
+void
+super_done (void)
+{
+  lock_acquire (&super_lock);
+  sb.clean = 1;
+  sb_dirty = true;
+  lock_release (&super_lock);
+}
+
+/* Hands the superblock to the journal if it changed.  Called by
+   the journal while it commits. */
+void
+super_commit (void)
+{
+  lock_acquire (&super_lock);
+  if (sb_dirty)
+  {
+    buffer_cache_write_meta (SUPERBLOCK_SECTOR, &sb, DISK_SECTOR_SIZE, 0);
+    sb_dirty = false;
+  }
+  lock_release (&super_lock);
+}
+
+/* Returns true if the file system was unmounted cleanly before
+   this mount. */
+bool
+super_was_clean (void)
+{
+  return was_clean;
+}
+
+/* Returns the number of free sectors. */
+size_t
+super_free_cnt (void)
+{
+  return sb.free_cnt;
+}
+
+/* Returns the number of inodes in use. */
+size_t
+super_inode_cnt (void)
+{
+  return sb.inode_cnt;
+}
+
+/* Returns the number of free sectors in GROUP. */
+size_t
+super_group_free (size_t group)
+{
+  ASSERT (group < sb.group_cnt);
+  return sb.group_free[group];
+}
+
+/* Sets the number of free sectors in GROUP to CNT. */
+void
+super_set_group_free (size_t group, size_t cnt)
+{
+  ASSERT (group < sb.group_cnt);
+  lock_acquire (&super_lock);
+  sb.free_cnt += cnt - sb.group_free[group];
+  sb.group_free[group] = cnt;
+  sb_dirty = true;
+  lock_release (&super_lock);
+}
+
+/* Adds DELTA to the number of free sectors in GROUP. */
+void
+super_add_free (size_t group, int delta)
+{
+  ASSERT (group < sb.group_cnt);
+  lock_acquire (&super_lock);
+  sb.group_free[group] += delta;
+  sb.free_cnt += delta;
+  sb_dirty = true;
+  lock_release (&super_lock);
+}
+
+/* Adds DELTA to the number of inodes in use. */
+void
+super_add_inodes (int delta)
+{
+  lock_acquire (&super_lock);
+  sb.inode_cnt += delta;
+  sb_dirty = true;
+  lock_release (&super_lock);
+}
+#endif
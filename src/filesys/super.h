@@ -0,0 +1,25 @@
+#ifndef FILESYS_SUPER_H
+#define FILESYS_SUPER_H
+#ifdef PRJ4
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+/* Number of sectors in a group, which is as many as one sector
+   of the free map covers.  The superblock keeps a free count for
+   each group. */
+#define SUPER_GROUP_SECTORS (DISK_SECTOR_SIZE * 8)
+
+void super_init (bool format);
+void super_done (void);
+void super_commit (void);
+bool super_was_clean (void);
+
+size_t super_free_cnt (void);
+size_t super_inode_cnt (void);
+size_t super_group_free (size_t group);
+void super_set_group_free (size_t group, size_t cnt);
+void super_add_free (size_t group, int delta);
+void super_add_inodes (int delta);
+#endif
+#endif /* filesys/super.h */
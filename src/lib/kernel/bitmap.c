@@ -359,6 +359,52 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Reads the CNT bits of B starting at START from FILE, leaving
+   the rest of B alone.  START must fall on an element boundary,
+   and so must START + CNT unless it is the end of B.  Returns
+   true if successful, false otherwise. */
+bool
+bitmap_read_range (struct bitmap *b, struct file *file,
+                   size_t start, size_t cnt)
+{
+  bool success = true;
+
+  ASSERT (b != NULL);
+  ASSERT (start % ELEM_BITS == 0);
+  ASSERT (start + cnt <= b->bit_cnt);
+  ASSERT (cnt % ELEM_BITS == 0 || start + cnt == b->bit_cnt);
+
+  if (cnt > 0)
+    {
+      off_t ofs = elem_idx (start) * sizeof (elem_type);
+      off_t size = byte_cnt (start + cnt) - ofs;
+      success = file_read_at (file, b->bits + elem_idx (start),
+                              size, ofs) == size;
+      if (start + cnt == b->bit_cnt)
+        b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+    }
+  return success;
+}
+
+/* Writes the CNT bits of B starting at START to FILE, with the
+   same limits on START and CNT as bitmap_read_range().  Returns
+   true if successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (b != NULL);
+  ASSERT (start % ELEM_BITS == 0);
+  ASSERT (start + cnt <= b->bit_cnt);
+  ASSERT (cnt % ELEM_BITS == 0 || start + cnt == b->bit_cnt);
+
+  ofs = elem_idx (start) * sizeof (elem_type);
+  size = byte_cnt (start + cnt) - ofs;
+  return file_write_at (file, b->bits + elem_idx (start), size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -28,7 +28,26 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+    SYS_FALLOCATE,              /* Preallocates space in a file. */
+    SYS_GETDENTS,               /* Reads several directory entries. */
+    SYS_COPY_FILE_RANGE,        /* Copies data from one file to another. */
+
+    /* Positional and vectored I/O. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write to a file from several buffers. */
+
+    /* Durability. */
+    SYS_FSYNC,                  /* Writes a file back to disk. */
+    SYS_SYNC,                   /* Writes every file back to disk. */
+
+    /* File system information. */
+    SYS_STATFS,                 /* Reports file system usage. */
+
+    /* Copy-on-write process creation. */
+    SYS_FORK                    /* Clones the current process. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -15,6 +15,36 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Directory entry written by getdents().
+   Must match struct dirent in filesys/directory.h. */
+struct dirent
+  {
+    int inumber;                        /* Inode number. */
+    bool isdir;                         /* Directory or ordinary file? */
+    char name[READDIR_MAX_LEN + 1];     /* Null terminated file name. */
+  };
+
+/* One buffer for readv() or writev().
+   Must match struct iovec in userprog/syscall.h. */
+struct iovec
+  {
+    void *iov_base;                     /* Start of buffer. */
+    unsigned iov_len;                   /* Size of buffer in bytes. */
+  };
+
+/* Most buffers one readv() or writev() call takes. */
+#define IOV_MAX 64
+
+/* File system usage written by statfs().
+   Must match struct statfs in userprog/syscall.h. */
+struct statfs
+  {
+    unsigned block_size;                /* Bytes in a block. */
+    unsigned block_cnt;                 /* Blocks on the disk. */
+    unsigned free_cnt;                  /* Free blocks. */
+    unsigned inode_cnt;                 /* Inodes in use. */
+  };
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -37,6 +67,7 @@ void close (int fd);
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
+pid_t fork (void);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -44,5 +75,21 @@ bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
+bool fallocate (int fd, unsigned offset, unsigned length);
+int getdents (int fd, struct dirent *entries, unsigned size);
+int copy_file_range (int in_fd, int out_fd, unsigned length);
+
+/* Positional and vectored I/O. */
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+
+/* Durability. */
+int fsync (int fd);
+void sync (void);
+
+/* File system information. */
+bool statfs (struct statfs *);
 
 #endif /* lib/user/syscall.h */
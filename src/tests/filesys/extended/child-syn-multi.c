@@ -0,0 +1,44 @@
+/* Child process for syn-multi.
+   Creates a file named after its child index and grows it in
+   chunks that do not line up with sector boundaries, so most
+   writes both fill a partial sector and allocate a new one. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-multi.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-multi";
+
+static char buf[FILE_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char file_name[16];
+  int child_idx;
+  size_t ofs;
+  int fd;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  snprintf (file_name, sizeof file_name, "file%d", child_idx);
+  memset (buf, 'a' + child_idx, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    CHECK (write (fd, buf + ofs, CHUNK_SIZE) == CHUNK_SIZE,
+           "write %d bytes at offset %zu in \"%s\"",
+           CHUNK_SIZE, ofs, file_name);
+  close (fd);
+
+  check_file (file_name, buf, sizeof buf);
+
+  return child_idx;
+}
@@ -0,0 +1,57 @@
+/* Child process for syn-throughput.
+   Makes a directory named after its child index and, ROUND_CNT
+   times, creates a file in it, writes it, reads it back through
+   a second open and removes it, so that nearly every system call
+   it makes goes through the file system. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-throughput.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-throughput";
+
+static char buf[BUF_SIZE];
+static char buf2[BUF_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char dir_name[16];
+  char file_name[32];
+  int child_idx;
+  int round;
+  int fd;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  snprintf (dir_name, sizeof dir_name, "dir%d", child_idx);
+  CHECK (mkdir (dir_name), "mkdir \"%s\"", dir_name);
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      snprintf (file_name, sizeof file_name, "%s/file%d", dir_name, round);
+      memset (buf, 'a' + (child_idx + round) % 26, sizeof buf);
+
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+             "write \"%s\"", file_name);
+      close (fd);
+
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      CHECK (read (fd, buf2, sizeof buf2) == sizeof buf2,
+             "read \"%s\"", file_name);
+      compare_bytes (buf2, buf, sizeof buf, 0, file_name);
+      close (fd);
+
+      CHECK (remove (file_name), "remove \"%s\"", file_name);
+    }
+
+  return child_idx;
+}
@@ -0,0 +1,58 @@
+/* Lists a directory with getdents(), using a buffer too small
+   to hold every entry at once, and checks the inode number and
+   type reported for each entry. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char *names[] = {"x", "y", "sub", "z"};
+#define NAME_CNT (sizeof names / sizeof *names)
+
+void
+test_main (void) 
+{
+  struct dirent entries[3];
+  int inumbers[NAME_CNT];
+  size_t found = 0;
+  int fd, cnt, i;
+  size_t j;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (chdir ("d"), "chdir \"d\"");
+  for (j = 0; j < NAME_CNT; j++)
+    {
+      if (!strcmp (names[j], "sub"))
+        CHECK (mkdir (names[j]), "mkdir \"%s\"", names[j]);
+      else
+        CHECK (create (names[j], 0), "create \"%s\"", names[j]);
+      CHECK ((fd = open (names[j])) > 1, "open \"%s\"", names[j]);
+      inumbers[j] = inumber (fd);
+      close (fd);
+    }
+
+  CHECK ((fd = open (".")) > 1, "open \".\"");
+  while ((cnt = getdents (fd, entries, sizeof entries)) > 0)
+    for (i = 0; i < cnt; i++)
+      {
+        struct dirent *e = &entries[i];
+
+        for (j = 0; j < NAME_CNT; j++)
+          if (!strcmp (e->name, names[j]))
+            break;
+        if (j == NAME_CNT)
+          fail ("getdents returned unexpected entry \"%s\"", e->name);
+        msg ("getdents returned \"%s\" (%s)", e->name,
+             e->isdir ? "directory" : "file");
+        if (e->isdir != !strcmp (names[j], "sub"))
+          fail ("wrong type for \"%s\"", e->name);
+        if (e->inumber != inumbers[j])
+          fail ("inumber of \"%s\" is %d, should be %d",
+                e->name, e->inumber, inumbers[j]);
+        found++;
+      }
+  CHECK (cnt == 0, "getdents at end of directory");
+  CHECK (found == NAME_CNT, "found %zu entries", found);
+  close (fd);
+}
@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "d"
+(dir-getdents) chdir "d"
+(dir-getdents) create "x"
+(dir-getdents) open "x"
+(dir-getdents) create "y"
+(dir-getdents) open "y"
+(dir-getdents) mkdir "sub"
+(dir-getdents) open "sub"
+(dir-getdents) create "z"
+(dir-getdents) open "z"
+(dir-getdents) open "."
+(dir-getdents) getdents returned "x" (file)
+(dir-getdents) getdents returned "y" (file)
+(dir-getdents) getdents returned "sub" (directory)
+(dir-getdents) getdents returned "z" (file)
+(dir-getdents) getdents at end of directory
+(dir-getdents) found 4 entries
+(dir-getdents) end
+EOF
+pass;
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($many);
+for my $i (0...149) {
+    $many->{$i % 2 ? "f$i" : "g$i"} = [''];
+}
+check_archive ({"many" => $many});
+pass;
@@ -0,0 +1,72 @@
+/* Fills a directory with enough files that it gets a hashed
+   index, removes every other one, checks that lookups find
+   exactly the files that are left, and then refills the freed
+   entries under new names. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 150
+
+static void
+make_name (char *name, size_t size, char prefix, int i) 
+{
+  snprintf (name, size, "/many/%c%d", prefix, i);
+}
+
+void
+test_main (void) 
+{
+  char name[32];
+  int i;
+
+  CHECK (mkdir ("/many"), "mkdir \"/many\"");
+
+  msg ("creating %d files in \"/many\"", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      make_name (name, sizeof name, 'f', i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  quiet = false;
+
+  msg ("removing every other file");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      make_name (name, sizeof name, 'f', i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+
+  msg ("checking lookups");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      int fd;
+
+      make_name (name, sizeof name, 'f', i);
+      fd = open (name);
+      if (i % 2 == 0)
+        CHECK (fd == -1, "open \"%s\" after removal", name);
+      else
+        {
+          CHECK (fd > 1, "open \"%s\"", name);
+          close (fd);
+        }
+    }
+  quiet = false;
+
+  msg ("refilling freed entries");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      make_name (name, sizeof name, 'g', i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+      CHECK (!create (name, 0), "create \"%s\" again", name);
+    }
+  quiet = false;
+}
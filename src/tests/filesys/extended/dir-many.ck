@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-many) begin
+(dir-many) mkdir "/many"
+(dir-many) creating 150 files in "/many"
+(dir-many) removing every other file
+(dir-many) checking lookups
+(dir-many) refilling freed entries
+(dir-many) end
+EOF
+pass;
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($deep) = {"c" => ["c" x 100]};
+$deep = {"deep0123456789" => $deep} for 1...7;
+check_archive ({"tree" => {"a" => ["a" x 3000],
+			   "sub" => {"b" => ["b" x 600]},
+			   "empty" => {},
+			   %$deep}});
+pass;
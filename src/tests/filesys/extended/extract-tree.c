@@ -0,0 +1,33 @@
+/* Checks the tree that the "extract" action unpacked from
+   extract-tree-src.tar before the test started: files in nested
+   directories, an empty directory, and a file whose path is too
+   long for the ustar name field alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEEP "/tree/deep0123456789/deep0123456789/deep0123456789" \
+             "/deep0123456789/deep0123456789/deep0123456789"      \
+             "/deep0123456789"
+
+static char buf[3000];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  memset (buf, 'a', 3000);
+  check_file ("/tree/a", buf, 3000);
+  memset (buf, 'b', 600);
+  check_file ("/tree/sub/b", buf, 600);
+  memset (buf, 'c', 100);
+  check_file (DEEP "/c", buf, 100);
+
+  CHECK ((fd = open ("/tree/empty")) > 1, "open \"/tree/empty\"");
+  CHECK (isdir (fd), "isdir \"/tree/empty\"");
+  msg ("close \"/tree/empty\"");
+  close (fd);
+}
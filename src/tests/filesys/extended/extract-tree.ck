@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($deep) = "/tree" . "/deep0123456789" x 7;
+check_expected (IGNORE_EXIT_CODES => 1, [<<EOF]);
+(extract-tree) begin
+(extract-tree) open "/tree/a" for verification
+(extract-tree) verified contents of "/tree/a"
+(extract-tree) close "/tree/a"
+(extract-tree) open "/tree/sub/b" for verification
+(extract-tree) verified contents of "/tree/sub/b"
+(extract-tree) close "/tree/sub/b"
+(extract-tree) open "$deep/c" for verification
+(extract-tree) verified contents of "$deep/c"
+(extract-tree) close "$deep/c"
+(extract-tree) open "/tree/empty"
+(extract-tree) isdir "/tree/empty"
+(extract-tree) close "/tree/empty"
+(extract-tree) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = random_bytes (23456);
+check_archive ({"source" => [$data], "copy" => [$data]});
+pass;
@@ -0,0 +1,49 @@
+/* Copies a file into a new, empty one with copy_file_range(),
+   in chunks that start and end partway through sectors, and
+   checks that the copy grew to match. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 23456
+#define CHUNK_SIZE 5000
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int src_fd, dst_fd;
+  int copied, total;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("source", 0), "create \"source\"");
+  CHECK ((src_fd = open ("source")) > 1, "open \"source\"");
+  CHECK (write (src_fd, buf, sizeof buf) == FILE_SIZE,
+         "write %d bytes to \"source\"", FILE_SIZE);
+  seek (src_fd, 0);
+
+  CHECK (create ("copy", 0), "create \"copy\"");
+  CHECK ((dst_fd = open ("copy")) > 1, "open \"copy\"");
+
+  msg ("copying \"source\" to \"copy\"");
+  total = 0;
+  while ((copied = copy_file_range (src_fd, dst_fd, CHUNK_SIZE)) > 0)
+    total += copied;
+  if (copied < 0)
+    fail ("copy_file_range failed after %d bytes", total);
+  CHECK (total == FILE_SIZE, "copied %d bytes", FILE_SIZE);
+  CHECK (filesize (dst_fd) == FILE_SIZE,
+         "filesize of \"copy\" is %d", FILE_SIZE);
+  CHECK (tell (src_fd) == FILE_SIZE && tell (dst_fd) == FILE_SIZE,
+         "both positions advanced to %d", FILE_SIZE);
+
+  msg ("close \"source\"");
+  close (src_fd);
+  msg ("close \"copy\"");
+  close (dst_fd);
+
+  check_file ("copy", buf, sizeof buf);
+}
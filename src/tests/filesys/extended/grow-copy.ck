@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-copy) begin
+(grow-copy) create "source"
+(grow-copy) open "source"
+(grow-copy) write 23456 bytes to "source"
+(grow-copy) create "copy"
+(grow-copy) open "copy"
+(grow-copy) copying "source" to "copy"
+(grow-copy) copied 23456 bytes
+(grow-copy) filesize of "copy" is 23456
+(grow-copy) both positions advanced to 23456
+(grow-copy) close "source"
+(grow-copy) close "copy"
+(grow-copy) open "copy" for verification
+(grow-copy) verified contents of "copy"
+(grow-copy) close "copy"
+(grow-copy) end
+EOF
+pass;
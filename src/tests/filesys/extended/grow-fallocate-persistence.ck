@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"logfile" => ["\0" x 1000 . "x" x 5000 . "\0" x 4000]});
+pass;
@@ -0,0 +1,43 @@
+/* Preallocates space for a file, checks that the preallocated
+   region reads back as zeros, and then writes into the middle
+   of it, starting and ending partway through sectors. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 10000
+#define WRITE_OFS 1000
+#define WRITE_SIZE 5000
+
+static char buf[FILE_SIZE];
+static char zeros[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "logfile";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (fallocate (fd, 0, FILE_SIZE),
+         "fallocate %d bytes in \"%s\"", FILE_SIZE, file_name);
+  CHECK (filesize (fd) == FILE_SIZE,
+         "filesize of \"%s\" is %d", file_name, FILE_SIZE);
+
+  CHECK (read (fd, buf, sizeof buf) == FILE_SIZE,
+         "read %d bytes from \"%s\"", FILE_SIZE, file_name);
+  compare_bytes (buf, zeros, sizeof buf, 0, file_name);
+
+  memset (buf + WRITE_OFS, 'x', WRITE_SIZE);
+  seek (fd, WRITE_OFS);
+  CHECK (write (fd, buf + WRITE_OFS, WRITE_SIZE) == WRITE_SIZE,
+         "write %d bytes at offset %d in \"%s\"",
+         WRITE_SIZE, WRITE_OFS, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  check_file (file_name, buf, sizeof buf);
+}
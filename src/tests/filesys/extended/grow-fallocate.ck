@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-fallocate) begin
+(grow-fallocate) create "logfile"
+(grow-fallocate) open "logfile"
+(grow-fallocate) fallocate 10000 bytes in "logfile"
+(grow-fallocate) filesize of "logfile" is 10000
+(grow-fallocate) read 10000 bytes from "logfile"
+(grow-fallocate) write 5000 bytes at offset 1000 in "logfile"
+(grow-fallocate) close "logfile"
+(grow-fallocate) open "logfile" for verification
+(grow-fallocate) verified contents of "logfile"
+(grow-fallocate) close "logfile"
+(grow-fallocate) end
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Grows a file past its first chain link, syncs it with fsync(),
+   checks that fsync() rejects a bad file descriptor, and then
+   syncs the whole file system with sync(). */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 70000
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "journal";
+  int fd;
+
+  memset (buf, 'y', sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == FILE_SIZE,
+         "write %d bytes to \"%s\"", FILE_SIZE, file_name);
+  CHECK (fsync (fd) == 0, "fsync \"%s\"", file_name);
+  CHECK (fsync (1234) == -1, "fsync bad fd");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  msg ("sync");
+  sync ();
+
+  check_file (file_name, buf, sizeof buf);
+}
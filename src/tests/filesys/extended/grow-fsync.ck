@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-fsync) begin
+(grow-fsync) create "journal"
+(grow-fsync) open "journal"
+(grow-fsync) write 70000 bytes to "journal"
+(grow-fsync) fsync "journal"
+(grow-fsync) fsync bad fd
+(grow-fsync) close "journal"
+(grow-fsync) sync
+(grow-fsync) open "journal" for verification
+(grow-fsync) verified contents of "journal"
+(grow-fsync) close "journal"
+(grow-fsync) end
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Checks that statfs() reports one more inode and fewer free
+   blocks after creating a file, and the same counts as before
+   once the file is removed and the removal is synced. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 5000
+
+void
+test_main (void) 
+{
+  const char *file_name = "statfs";
+  struct statfs before, during, after;
+
+  /* Let the root directory make room for the name first, so
+     that the counts only change with the file itself. */
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+  msg ("sync");
+  sync ();
+
+  CHECK (statfs (&before), "statfs");
+  CHECK (before.block_size == 512, "block size is 512");
+  CHECK (before.free_cnt < before.block_cnt, "some blocks in use");
+
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  CHECK (statfs (&during), "statfs");
+  CHECK (during.inode_cnt == before.inode_cnt + 1, "one more inode");
+  CHECK (during.free_cnt + FILE_SIZE / 512 < before.free_cnt,
+         "fewer free blocks");
+
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+  msg ("sync");
+  sync ();
+  CHECK (statfs (&after), "statfs");
+  CHECK (after.inode_cnt == before.inode_cnt, "inode count restored");
+  CHECK (after.free_cnt == before.free_cnt, "free count restored");
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-statfs) begin
+(grow-statfs) create "statfs"
+(grow-statfs) remove "statfs"
+(grow-statfs) sync
+(grow-statfs) statfs
+(grow-statfs) block size is 512
+(grow-statfs) some blocks in use
+(grow-statfs) create "statfs"
+(grow-statfs) statfs
+(grow-statfs) one more inode
+(grow-statfs) fewer free blocks
+(grow-statfs) remove "statfs"
+(grow-statfs) sync
+(grow-statfs) statfs
+(grow-statfs) inode count restored
+(grow-statfs) free count restored
+(grow-statfs) end
+EOF
+pass;
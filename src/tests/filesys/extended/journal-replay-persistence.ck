@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+fail "journal was not replayed"
+  if !grep (/^journal: replayed \d+ sectors\.$/,
+	    read_text_file ("$test.output"));
+my ($log) = {"data" => ["j" x 5000]};
+for my $i (0...39) {
+    $log->{"f$i"} = [''] if $i % 3;
+}
+check_archive ({"log" => $log});
+pass;
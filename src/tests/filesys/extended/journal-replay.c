@@ -0,0 +1,56 @@
+/* Fills a directory until it gets a hashed index, removes some
+   of its files and writes another one.  The kernel runs with
+   "-journal-crash", so its last commit stops after the commit
+   record and the extraction run has to replay the journal. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 40
+#define FILE_SIZE 5000
+
+static char buf[FILE_SIZE];
+
+static void
+make_name (char *name, size_t size, int i) 
+{
+  snprintf (name, size, "/log/f%d", i);
+}
+
+void
+test_main (void) 
+{
+  char name[32];
+  int fd, i;
+
+  CHECK (mkdir ("/log"), "mkdir \"/log\"");
+
+  msg ("creating %d files in \"/log\"", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      make_name (name, sizeof name, i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  quiet = false;
+
+  msg ("removing every third file");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i += 3)
+    {
+      make_name (name, sizeof name, i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+
+  memset (buf, 'j', sizeof buf);
+  CHECK (create ("/log/data", 0), "create \"/log/data\"");
+  CHECK ((fd = open ("/log/data")) > 1, "open \"/log/data\"");
+  CHECK (write (fd, buf, sizeof buf) == FILE_SIZE,
+         "write %d bytes to \"/log/data\"", FILE_SIZE);
+  msg ("close \"/log/data\"");
+  close (fd);
+}
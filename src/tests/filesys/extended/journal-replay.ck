@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-replay) begin
+(journal-replay) mkdir "/log"
+(journal-replay) creating 40 files in "/log"
+(journal-replay) removing every third file
+(journal-replay) create "/log/data"
+(journal-replay) open "/log/data"
+(journal-replay) write 5000 bytes to "/log/data"
+(journal-replay) close "/log/data"
+(journal-replay) end
+EOF
+pass;
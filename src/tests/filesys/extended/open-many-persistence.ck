@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($tree);
+for my $d (0...31) {
+    for my $i (0...31) {
+	$tree->{"d$d"}{"f$i"} = [''];
+    }
+}
+check_archive ($tree);
+pass;
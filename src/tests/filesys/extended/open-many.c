@@ -0,0 +1,65 @@
+/* Creates 1,024 files spread over 32 directories, keeps all of
+   them open at once, and then opens and closes every file again
+   several times.  Every reopen has to find an inode that is
+   already in the open-inode table, so the kernel tick count
+   printed at power off measures the cost of that lookup. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DIR_CNT 32
+#define FILE_CNT 32
+#define REOPEN_CNT 4
+
+static int fds[DIR_CNT * FILE_CNT];
+
+void
+test_main (void) 
+{
+  char name[32];
+  int d, i, pass;
+
+  msg ("creating %d files...", DIR_CNT * FILE_CNT);
+  quiet = true;
+  for (d = 0; d < DIR_CNT; d++)
+    {
+      snprintf (name, sizeof name, "/d%d", d);
+      CHECK (mkdir (name), "mkdir \"%s\"", name);
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          snprintf (name, sizeof name, "/d%d/f%d", d, i);
+          CHECK (create (name, 0), "create \"%s\"", name);
+        }
+    }
+  quiet = false;
+
+  msg ("opening all files...");
+  quiet = true;
+  for (d = 0; d < DIR_CNT; d++)
+    for (i = 0; i < FILE_CNT; i++)
+      {
+        snprintf (name, sizeof name, "/d%d/f%d", d, i);
+        CHECK ((fds[d * FILE_CNT + i] = open (name)) > 1,
+               "open \"%s\"", name);
+      }
+  quiet = false;
+
+  msg ("reopening every file %d times...", REOPEN_CNT);
+  quiet = true;
+  for (pass = 0; pass < REOPEN_CNT; pass++)
+    for (d = 0; d < DIR_CNT; d++)
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          int fd;
+          snprintf (name, sizeof name, "/d%d/f%d", d, i);
+          CHECK ((fd = open (name)) > 1, "reopen \"%s\"", name);
+          close (fd);
+        }
+  quiet = false;
+
+  msg ("closing all files...");
+  for (i = 0; i < DIR_CNT * FILE_CNT; i++)
+    close (fds[i]);
+}
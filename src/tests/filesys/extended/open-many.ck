@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(open-many) begin
+(open-many) creating 1024 files...
+(open-many) opening all files...
+(open-many) reopening every file 4 times...
+(open-many) closing all files...
+(open-many) end
+EOF
+pass;
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($size) = 300 * 64;
+check_archive ({"child-syn-multi" => "tests/filesys/extended/child-syn-multi",
+		"file0" => ["a" x $size],
+		"file1" => ["b" x $size],
+		"file2" => ["c" x $size],
+		"file3" => ["d" x $size]});
+pass;
@@ -0,0 +1,35 @@
+/* Has several subprocesses grow files of their own at the same
+   time, then checks that every file came out right.  Growing a
+   file allocates sectors from the shared free map, so the writes
+   contend there even though no file is shared.  As with
+   syn-throughput, the "Timer:" tick count printed at power off
+   measures how well the writes proceed in parallel: compare it
+   across kernels, or against a run with CHILD_CNT set to 1. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-multi.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  exec_children ("child-syn-multi", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "file%d", i);
+      memset (buf, 'a' + i, sizeof buf);
+      check_file (file_name, buf, sizeof buf);
+    }
+}
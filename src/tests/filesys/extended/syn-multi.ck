@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-multi) begin
+(syn-multi) exec child 1 of 4: "child-syn-multi 0"
+(syn-multi) exec child 2 of 4: "child-syn-multi 1"
+(syn-multi) exec child 3 of 4: "child-syn-multi 2"
+(syn-multi) exec child 4 of 4: "child-syn-multi 3"
+(syn-multi) wait for child 1 of 4 returned 0 (expected 0)
+(syn-multi) wait for child 2 of 4 returned 1 (expected 1)
+(syn-multi) wait for child 3 of 4 returned 2 (expected 2)
+(syn-multi) wait for child 4 of 4 returned 3 (expected 3)
+(syn-multi) open "file0" for verification
+(syn-multi) verified contents of "file0"
+(syn-multi) close "file0"
+(syn-multi) open "file1" for verification
+(syn-multi) verified contents of "file1"
+(syn-multi) close "file1"
+(syn-multi) open "file2" for verification
+(syn-multi) verified contents of "file2"
+(syn-multi) close "file2"
+(syn-multi) open "file3" for verification
+(syn-multi) verified contents of "file3"
+(syn-multi) close "file3"
+(syn-multi) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_MULTI_H
+#define TESTS_FILESYS_EXTENDED_SYN_MULTI_H
+
+#define CHILD_CNT 4
+#define CHUNK_SIZE 300
+#define CHUNK_CNT 64
+#define FILE_SIZE (CHUNK_SIZE * CHUNK_CNT)
+
+#endif /* tests/filesys/extended/syn-multi.h */
@@ -0,0 +1,31 @@
+/* Has several subprocesses create, write, read back and remove
+   files in directories of their own at the same time, as a
+   benchmark of how file system calls from independent processes
+   scale.  Nothing is shared but the root directory, the free map
+   and the buffer cache, so the children only wait for each other
+   there; compare the "Timer:" tick count printed at power off
+   across kernels, or against a run with fewer children. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-throughput.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  exec_children ("child-syn-throughput", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      char dir_name[16];
+
+      snprintf (dir_name, sizeof dir_name, "dir%d", i);
+      CHECK (remove (dir_name), "remove \"%s\"", dir_name);
+    }
+}
@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-throughput) begin
+(syn-throughput) exec child 1 of 8: "child-syn-throughput 0"
+(syn-throughput) exec child 2 of 8: "child-syn-throughput 1"
+(syn-throughput) exec child 3 of 8: "child-syn-throughput 2"
+(syn-throughput) exec child 4 of 8: "child-syn-throughput 3"
+(syn-throughput) exec child 5 of 8: "child-syn-throughput 4"
+(syn-throughput) exec child 6 of 8: "child-syn-throughput 5"
+(syn-throughput) exec child 7 of 8: "child-syn-throughput 6"
+(syn-throughput) exec child 8 of 8: "child-syn-throughput 7"
+(syn-throughput) wait for child 1 of 8 returned 0 (expected 0)
+(syn-throughput) wait for child 2 of 8 returned 1 (expected 1)
+(syn-throughput) wait for child 3 of 8 returned 2 (expected 2)
+(syn-throughput) wait for child 4 of 8 returned 3 (expected 3)
+(syn-throughput) wait for child 5 of 8 returned 4 (expected 4)
+(syn-throughput) wait for child 6 of 8 returned 5 (expected 5)
+(syn-throughput) wait for child 7 of 8 returned 6 (expected 6)
+(syn-throughput) wait for child 8 of 8 returned 7 (expected 7)
+(syn-throughput) remove "dir0"
+(syn-throughput) remove "dir1"
+(syn-throughput) remove "dir2"
+(syn-throughput) remove "dir3"
+(syn-throughput) remove "dir4"
+(syn-throughput) remove "dir5"
+(syn-throughput) remove "dir6"
+(syn-throughput) remove "dir7"
+(syn-throughput) end
+EOF
+pass;
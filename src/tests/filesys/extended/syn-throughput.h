@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_THROUGHPUT_H
+#define TESTS_FILESYS_EXTENDED_SYN_THROUGHPUT_H
+
+#define CHILD_CNT 8
+#define ROUND_CNT 32
+#define BUF_SIZE 700
+
+#endif /* tests/filesys/extended/syn-throughput.h */
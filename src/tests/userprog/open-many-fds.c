@@ -0,0 +1,43 @@
+/* Opens "sample.txt" a couple of thousand times, then reads a
+   byte at a time through every descriptor for several rounds,
+   so that the cost of looking up a descriptor dominates.  Also
+   checks that closed descriptors are reused lowest first. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 2000
+#define ROUND_CNT 16
+
+static int handles[FILE_CNT];
+
+void
+test_main (void) 
+{
+  int i, round;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      handles[i] = open ("sample.txt");
+      if (handles[i] < 2)
+        fail ("open #%d of \"sample.txt\" failed", i);
+    }
+  msg ("opened \"sample.txt\" %d times", FILE_CNT);
+
+  for (round = 0; round < ROUND_CNT; round++)
+    for (i = 0; i < FILE_CNT; i++)
+      {
+        char c;
+        if (read (handles[i], &c, 1) != 1 || c != sample[round])
+          fail ("read #%d through handle %d went wrong", round, handles[i]);
+      }
+  msg ("read %d bytes through each handle", ROUND_CNT);
+
+  close (handles[FILE_CNT / 2]);
+  close (handles[3]);
+  CHECK (open ("sample.txt") == handles[3], "reopen takes lowest free fd");
+  CHECK (open ("sample.txt") == handles[FILE_CNT / 2],
+         "next reopen takes the other free fd");
+}
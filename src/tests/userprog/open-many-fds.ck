@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many-fds) begin
+(open-many-fds) opened "sample.txt" 2000 times
+(open-many-fds) read 16 bytes through each handle
+(open-many-fds) reopen takes lowest free fd
+(open-many-fds) next reopen takes the other free fd
+(open-many-fds) end
+open-many-fds: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Reads "sample.txt" backward in small pieces with pread(),
+   which must leave the file position alone, then overwrites a
+   piece of a copy with pwrite(). */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PIECE 16
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  int handle, ofs;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  for (ofs = ((sizeof sample - 1) / PIECE) * PIECE; ofs >= 0; ofs -= PIECE)
+    {
+      int size = sizeof sample - 1 - ofs < PIECE ? sizeof sample - 1 - ofs
+                                                 : PIECE;
+      if (pread (handle, buf + ofs, size, ofs) != size)
+        fail ("pread() of %d bytes at offset %d failed", size, ofs);
+    }
+  compare_bytes (buf, sample, sizeof sample - 1, 0, "sample.txt");
+  CHECK (tell (handle) == 0, "file position is still 0");
+  close (handle);
+
+  CHECK (create ("test.txt", sizeof sample - 1), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (write (handle, sample, sizeof sample - 1) == sizeof sample - 1,
+         "write \"test.txt\"");
+  CHECK (pwrite (handle, "xyzzy", 5, 10) == 5, "pwrite 5 bytes at offset 10");
+  CHECK (tell (handle) == sizeof sample - 1, "file position is unchanged");
+  memcpy (buf, sample, sizeof sample - 1);
+  memcpy (buf + 10, "xyzzy", 5);
+  close (handle);
+  check_file ("test.txt", buf, sizeof sample - 1);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-normal) begin
+(pread-normal) open "sample.txt"
+(pread-normal) file position is still 0
+(pread-normal) create "test.txt"
+(pread-normal) open "test.txt"
+(pread-normal) write "test.txt"
+(pread-normal) pwrite 5 bytes at offset 10
+(pread-normal) file position is unchanged
+(pread-normal) open "test.txt" for verification
+(pread-normal) verified contents of "test.txt"
+(pread-normal) close "test.txt"
+(pread-normal) end
+pread-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Writes "sample.txt"'s contents to a new file with one
+   writev() call of three pieces, then reads them back with one
+   readv() call of three differently sized pieces. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static char a[50], b[100], c[sizeof sample];
+  struct iovec out[3], in[3];
+  int handle, size = sizeof sample - 1;
+
+  out[0].iov_base = sample;
+  out[0].iov_len = 20;
+  out[1].iov_base = sample + 20;
+  out[1].iov_len = 0;
+  out[2].iov_base = sample + 20;
+  out[2].iov_len = size - 20;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (writev (handle, out, 3) == size, "writev %d bytes", size);
+
+  in[0].iov_base = a;
+  in[0].iov_len = sizeof a;
+  in[1].iov_base = b;
+  in[1].iov_len = sizeof b;
+  in[2].iov_base = c;
+  in[2].iov_len = sizeof c;
+  seek (handle, 0);
+  CHECK (readv (handle, in, 3) == size, "readv %d bytes", size);
+  compare_bytes (a, sample, sizeof a, 0, "test.txt");
+  compare_bytes (b, sample + sizeof a, sizeof b, sizeof a, "test.txt");
+  compare_bytes (c, sample + sizeof a + sizeof b, size - sizeof a - sizeof b,
+                 sizeof a + sizeof b, "test.txt");
+  close (handle);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-normal) begin
+(readv-normal) create "test.txt"
+(readv-normal) open "test.txt"
+(readv-normal) writev 239 bytes
+(readv-normal) readv 239 bytes
+(readv-normal) end
+readv-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,55 @@
+/* Forks a process that overwrites 256 kB of memory it shares
+   with its parent and verifies that neither sees the other's
+   copy afterward. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (256 * 1024)
+
+static char buf[SIZE];
+
+/* Returns true if every byte of BUF is VALUE. */
+static bool
+all_equal (char value)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != value)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  msg ("initialize");
+  memset (buf, 0x5a, sizeof buf);
+
+  child = fork ();
+  if (child == 0)
+    {
+      /* The child must start out with the parent's data and
+         keep its own writes to itself. */
+      if (!all_equal (0x5a))
+        exit (1);
+      memset (buf, 0xa5, sizeof buf);
+      exit (all_equal (0xa5) ? 81 : 2);
+    }
+  CHECK (child != PID_ERROR, "fork");
+  CHECK (wait (child) == 81, "wait for child");
+
+  msg ("parent's copy unchanged");
+  if (!all_equal (0x5a))
+    fail ("parent sees child's writes");
+
+  msg ("write parent's copy");
+  memset (buf, 0x3c, sizeof buf);
+  if (!all_equal (0x3c))
+    fail ("parent lost its own writes");
+}
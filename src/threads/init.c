@@ -30,12 +30,16 @@
 #include "tests/threads/tests.h"
 #endif
 #ifdef PRJ3
+#include "vm/page.h"
+#include "vm/pagecache.h"
 #include "vm/swap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/journal.h"
 #endif
 
 /* Amount of physical memory, in 4 kB pages. */
@@ -112,6 +116,9 @@ main (void)
   serial_init_queue ();
   timer_calibrate ();
 
+#ifdef PRJ3
+  pcache_init ();
+#endif
 #ifdef FILESYS
   /* Initialize file system. */
   disk_init ();
@@ -119,6 +126,7 @@ main (void)
 #endif
 #ifdef PRJ3
   swap_table_bitmap_init ();
+  frame_table_init ();
 #endif
 #ifdef PRJ4
   write_back_start ();
@@ -248,6 +256,12 @@ parse_options (char **argv)
 #ifdef FILESYS
       else if (!strcmp (name, "-f"))
         format_filesys = true;
+#ifdef PRJ4
+      else if (!strcmp (name, "-fixed-dirs"))
+        dir_fixed_format = true;
+      else if (!strcmp (name, "-journal-crash"))
+        journal_crash = true;
+#endif
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -302,6 +316,7 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"put", 2, fsutil_put},
       {"get", 2, fsutil_get},
+      {"extract", 1, fsutil_extract},
 #endif
       {NULL, 0, NULL},
     };
@@ -348,14 +363,19 @@ usage (void)
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
-          "Use these actions indirectly via `pintos' -g and -p options:\n"
+          "Use these actions indirectly via `pintos' -g, -p and -x options:\n"
           "  put FILE           Put FILE into file system from scratch disk.\n"
           "  get FILE           Get FILE from file system into scratch disk.\n"
+          "  extract            Extract ustar archive from scratch disk.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
           "  -q                 Power off VM after actions or on panic.\n"
           "  -f                 Format file system disk during startup.\n"
+#if defined (FILESYS) && defined (PRJ4)
+          "  -fixed-dirs        Format with fixed-size directory entries.\n"
+          "  -journal-crash     Stop the last journal commit half-way.\n"
+#endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
@@ -404,4 +424,7 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef PRJ3
+  page_print_stats ();
+#endif
 }
@@ -188,6 +188,24 @@ page_from_pool (const struct pool *pool, void *page)
   return page_no >= start_page && page_no < end_page;
 }
 
+#ifdef PRJ3
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void)
+{
+  return bitmap_size (user_pool.used_map);
+}
+
+/* Returns the index of PAGE within the user pool, which PAGE
+   must have been allocated from. */
+size_t
+palloc_user_page_no (void *page)
+{
+  ASSERT (page_from_pool (&user_pool, page));
+  return pg_no (page) - pg_no (user_pool.base);
+}
+#endif
+
 #ifdef PRJ4
 void
 print_all_kernel_pool (void)
@@ -19,6 +19,10 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+#ifdef PRJ3
+size_t palloc_user_page_cnt (void);
+size_t palloc_user_page_no (void *);
+#endif
 #ifdef PRJ4
 void print_all_kernel_pool (void);
 #endif
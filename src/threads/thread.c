@@ -7,6 +7,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
@@ -17,6 +18,9 @@
 #ifdef PRJ3
 #include "filesys/file.h"
 #endif
+#ifdef PRJ4
+#include "filesys/journal.h"
+#endif
 
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
@@ -39,19 +43,14 @@ static struct thread *idle_thread;
 static struct thread *initial_thread;
 
 #ifdef PRJ4
-/* write back kernel thread, which repeats for every 
- * WRITE_BACK_PERIOD */
+/* write back kernel thread, which commits the journal and writes
+ * data back every WRITE_BACK_PERIOD */
 static struct thread *write_back_thread;
 #endif
 
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
-#ifdef USERPROG
-/* lock used for open, close, etc */
-static struct lock file_rw_lock;
-#endif
-
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -110,12 +109,6 @@ thread_init (void)
   lock_init (&tid_lock);
   lock_init (&ready_lock);
   list_init (&ready_list);
-#ifdef USERPROG
-  lock_init (&file_rw_lock);
-#endif
-#ifdef PRJ3
-  frame_table_init ();
-#endif
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -517,7 +510,7 @@ repeat_write_back (void *write_back_started_ UNUSED)
   for (;;)
   {
     timer_sleep (WRITE_BACK_PERIOD);
-    buffer_cache_write_back ();
+    journal_commit ();
   }
 }
 #endif
@@ -578,14 +571,13 @@ init_thread (struct thread *t, const char *name, int priority)
   if(!is_thread(t->tparent)) t->tparent = t;
   t->ttmpchild = NULL;
   // recursively set current thread's level
-  t->next_fd = 2;
+  t->fd_free = 2;
   t->child_success = false;
   t->exec_file = NULL;
   sema_init(&t->creation_sema,0);
-  list_init(&t->file_list);
   list_init(&t->child_list);
   lock_init(&t->child_list_lock);
-  lock_init (&t->file_list_lock);
+  lock_init (&t->fd_table_lock);
 #endif
 #ifdef PRJ3
   t->next_mid = 0;
@@ -595,6 +587,7 @@ init_thread (struct thread *t, const char *name, int priority)
 #endif
 #ifdef PRJ4
   t->current_dir = 1;
+  t->journal_depth = 0;
 #endif
 }
 
@@ -768,40 +761,76 @@ thread_find (tid_t tid)
 }
 
 #ifdef USERPROG
+/* Smallest fd table, in slots. */
+#define FD_TABLE_MIN 16
+
 /* return file_elem* with given fd */
 struct file_elem*
 find_file (int fd)
 {
-  struct list_elem* elem_pointer = NULL;
   struct file_elem* i = NULL;
   struct thread* tcurrent = thread_current();
 
-  lock_acquire (&tcurrent->file_list_lock);
-  elem_pointer = list_begin(&(tcurrent->file_list));
-  while (elem_pointer != list_end(&tcurrent->file_list))
+  lock_acquire (&tcurrent->fd_table_lock);
+  if (fd >= 0 && fd < tcurrent->fd_table_size)
+    i = tcurrent->fd_table[fd];
+  lock_release (&tcurrent->fd_table_lock);
+  return i;
+}
+
+/* Gives FE the lowest free fd of the current thread, growing the
+   fd table if it is full.  Returns the fd, or -1 if the table
+   cannot grow. */
+int
+add_file (struct file_elem *fe)
+{
+  struct thread* tcurrent = thread_current();
+  int fd;
+
+  lock_acquire (&tcurrent->fd_table_lock);
+  fd = tcurrent->fd_free;
+  while (fd < tcurrent->fd_table_size && tcurrent->fd_table[fd] != NULL)
+    fd++;
+  if (fd >= tcurrent->fd_table_size)
   {
-    i = list_entry(elem_pointer, struct file_elem, elem);
-    elem_pointer = list_next(elem_pointer);
-    if (i->fd == fd)
+    int old_size = tcurrent->fd_table_size;
+    int new_size = old_size * 2 > FD_TABLE_MIN ? old_size * 2 : FD_TABLE_MIN;
+    struct file_elem **table = realloc (tcurrent->fd_table,
+                                        new_size * sizeof *table);
+    if (table == NULL)
     {
-      lock_release (&tcurrent->file_list_lock);
-      return i;
+      lock_release (&tcurrent->fd_table_lock);
+      return -1;
     }
+    memset (table + old_size, 0, (new_size - old_size) * sizeof *table);
+    tcurrent->fd_table = table;
+    tcurrent->fd_table_size = new_size;
   }
-  lock_release (&tcurrent->file_list_lock);
-  return NULL;
+  tcurrent->fd_table[fd] = fe;
+  tcurrent->fd_free = fd + 1;
+  fe->fd = fd;
+  lock_release (&tcurrent->fd_table_lock);
+  return fd;
 }
 
-void
-file_lock_acquire(void)
+/* Frees FD in the current thread's fd table and returns the
+   file_elem it held, or a null pointer if FD was not open. */
+struct file_elem *
+remove_file (int fd)
 {
-  lock_acquire(&file_rw_lock);
-}
+  struct file_elem* i = NULL;
+  struct thread* tcurrent = thread_current();
 
-void
-file_lock_release(void)
-{
-  lock_release(&file_rw_lock);
+  lock_acquire (&tcurrent->fd_table_lock);
+  if (fd >= 0 && fd < tcurrent->fd_table_size)
+  {
+    i = tcurrent->fd_table[fd];
+    tcurrent->fd_table[fd] = NULL;
+    if (i != NULL && fd < tcurrent->fd_free)
+      tcurrent->fd_free = fd;
+  }
+  lock_release (&tcurrent->fd_table_lock);
+  return i;
 }
 
 /* need to acuire lock before call this func */
@@ -909,16 +938,16 @@ void
 print_all_filelist (void)
 {
   struct thread *tcurrent = thread_current ();
-  printf ("thread : %d, total filelist : %d\n",\
-      tcurrent->tid, list_size (&tcurrent->file_list));
+  printf ("thread : %d, fd table size : %d\n",\
+      tcurrent->tid, tcurrent->fd_table_size);
   struct file_elem* fi;
-  struct list_elem* elem_pointer = list_begin (&tcurrent->file_list);
-  while (elem_pointer != list_end (&tcurrent->file_list))
+  int fd;
+  for (fd = 0; fd < tcurrent->fd_table_size; fd++)
   {
-    fi = list_entry (elem_pointer, struct file_elem, elem);
-    printf ("fd : %d, f : %p, d : %p\n",\
-        fi->fd, fi->f, fi->d);
-    elem_pointer = list_next (elem_pointer);
+    fi = tcurrent->fd_table[fd];
+    if (fi != NULL)
+      printf ("fd : %d, f : %p, d : %p\n",\
+          fi->fd, fi->f, fi->d);
   }
 }
 #endif
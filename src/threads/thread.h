@@ -48,7 +48,6 @@ struct child_elem
 
 struct file_elem
 {
-  struct list_elem elem;
   struct file* f;
 #ifdef PRJ4
   struct dir *d;
@@ -159,11 +158,12 @@ struct thread
     bool child_success;
     struct thread* ttmpchild;
 
-    // struct file* 와 대응하는 file descriptor(int)의 리스트
-    struct list file_list;
-    struct lock file_list_lock;
-    // 다음 할당될 fd
-    int next_fd;
+    // fd로 바로 찾는 struct file_elem* 배열, 빈 fd는 NULL
+    struct file_elem **fd_table;
+    int fd_table_size;
+    // 이보다 작은 fd 중에는 빈 fd가 없음
+    int fd_free;
+    struct lock fd_table_lock;
     struct file* exec_file;
 
     /* Owned by userprog/process.c. */
@@ -179,6 +179,7 @@ struct thread
 #endif
 #ifdef PRJ4
     disk_sector_t current_dir;
+    int journal_depth;                  /* Nesting of journal_begin(). */
 #endif
 
     /* Owned by thread.c. */
@@ -228,9 +229,9 @@ bool higher_priority (struct list_elem* x, struct list_elem* y, void* aux UNUSED
 
 #ifdef USERPROG
 struct file_elem* find_file(int fd);
+int add_file (struct file_elem *);
+struct file_elem *remove_file (int fd);
 struct child_elem* find_child(tid_t tid, struct thread* t);
-void file_lock_acquire(void);
-void file_lock_release(void);
 #endif
 
 #ifdef PRJ3
@@ -1,9 +1,15 @@
 #include "userprog/exception.h"
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef PRJ3
+#include "filesys/file.h"
+#include "userprog/pagedir.h"
+#include "vm/pagecache.h"
+#endif
 #define STACK_BASE 0xb8000000
 
 /* Number of page faults processed. */
@@ -178,20 +184,34 @@ page_fault (struct intr_frame *f)
   size_t swapping_index;
   disk_sector_t i;
   int count;
+  bool victim_mapped;
+  // 아무도 map하지 않은 page cache frame이 있으면 그것부터 돌려받는다.
+  if (kpage == NULL && pcache_reclaim ())
+    kpage = palloc_get_page (PAL_USER|PAL_ZERO);
   if (kpage == NULL)
   {
     // swap out
     struct disk* d;
     swapping_index = swap_table_scan_and_flip();
 
-    fr_elem = frame_table_find_victim();
+    fr_elem = frame_table_find_victim (&victim_mapped);
     ASSERT(fr_elem != NULL);
     struct page* victim_page = page_lookup (fr_elem->vaddr, fr_elem->pd_thread);
     ASSERT (victim_page != NULL)
+    bool victim_shared = victim_page->shared;
     uint8_t* victim_kvaddr = pagedir_get_page(fr_elem->pd, fr_elem->vaddr);
-    pagedir_clear_page(fr_elem->pd, fr_elem->vaddr);
+    if (!victim_shared)
+      pagedir_clear_page(fr_elem->pd, fr_elem->vaddr);
 
-    if (!victim_page->mmaped)
+    if (victim_shared)
+    {
+      // page cache의 frame은 그 page를 map한 모든 프로세스에서
+      // 한꺼번에 unmap하고 free한다. 파일에서 다시 읽으면 되므로
+      // swap은 필요 없다.
+      swap_table_unflip (swapping_index);
+      pcache_evict (fr_elem->pd, fr_elem->vaddr);
+    }
+    else if (!victim_page->mmaped)
     {
       d = disk_get(1,1);
       ASSERT(victim_kvaddr);
@@ -214,8 +234,10 @@ page_fault (struct intr_frame *f)
       }
     }
 
-    palloc_free_page(victim_kvaddr);
-    free (fr_elem);
+    // fork한 다른 프로세스가 아직 map하고 있는 frame은 free하지 않는다.
+    if (!victim_shared && !victim_mapped)
+      palloc_free_page(victim_kvaddr);
+    frame_elem_free (fr_elem);
 
     kpage = palloc_get_page (PAL_USER|PAL_ZERO);
     swap_lock_release ();
@@ -238,7 +260,7 @@ page_fault (struct intr_frame *f)
         && checkheuristic
         && is_user_vaddr(fault_addr))
     {
-      struct page* pi = malloc (sizeof(struct page));
+      struct page* pi = page_fault_malloc (sizeof(struct page));
       if (pi == NULL)
         return false;
       pi->load_vaddr = upage;
@@ -250,23 +272,26 @@ page_fault (struct intr_frame *f)
       pi->swap_index = 0;
       pi->f = NULL;
       pi->mmaped = false;
+      pi->shared = false;
+      pi->cow = false;
       supplementary_lock_acquire(tcurrent);
       hash_replace (&tcurrent->supplementary_page_table, &pi->elem);
       supplementary_lock_release(tcurrent);
 
-      fr_elem = malloc (sizeof(struct frame_elem));
-      fr_elem->pd = tcurrent->pagedir;
-      fr_elem->vaddr = upage;
-      fr_elem->pd_thread = tcurrent;
-      frame_table_push_back(fr_elem);
-
       /* Add the page to the process's address space. */
       if (pagedir_get_page (tcurrent->pagedir, upage) != NULL
         || !pagedir_set_page (tcurrent->pagedir, upage, kpage, true)) 
       {
         palloc_free_page (kpage);
         printf("whatthe 4\n");
+        return ;
       }
+
+      fr_elem = frame_elem_alloc ();
+      fr_elem->pd = tcurrent->pagedir;
+      fr_elem->vaddr = upage;
+      fr_elem->pd_thread = tcurrent;
+      frame_table_push_back(fr_elem);
       return ; 
     }
     else
@@ -288,6 +313,7 @@ page_fault (struct intr_frame *f)
   bool writable = faulted_page->writable;
   bool swap_out = faulted_page->swap_outed;
   uint32_t swap_index = faulted_page->swap_index;
+  bool cow = faulted_page->cow;
   swap_lock_release ();
   if(filepos < 0 || read_bytes < 0)
   {
@@ -299,7 +325,31 @@ page_fault (struct intr_frame *f)
     // do lazy load
     if (!swap_out)
     {
-      if (file_read_at (ff, kpage, read_bytes, filepos) != (int) read_bytes)
+      // 읽기 전용 file page는 page cache의 frame을 모든 프로세스가
+      // 함께 map한다. 쓰기 가능한 page와 mmap page는 각자 복사본을 갖는다.
+      // pcache_map()이 map한 순간부터 eviction 대상이 되므로
+      // shared는 미리 켜 둔다.
+      bool shared = false;
+      if (!writable && ff != NULL && !faulted_page->mmaped)
+      {
+        supplementary_lock_acquire (tcurrent);
+        faulted_page->shared = true;
+        supplementary_lock_release (tcurrent);
+        kpage = pcache_map (file_get_inode (ff), filepos, read_bytes,
+                            kpage, tcurrent, upage, &shared);
+        supplementary_lock_acquire (tcurrent);
+        faulted_page->shared = shared;
+        supplementary_lock_release (tcurrent);
+        if (kpage == NULL)
+        {
+          printf("%s: exit(%d)\n", thread_current()->name, -1);
+          thread_exit (); 
+          return ; 
+        }
+        if (shared)
+          return ;
+      }
+      else if (file_read_at (ff, kpage, read_bytes, filepos) != (int) read_bytes)
       {
         palloc_free_page (kpage);
         printf("%s: exit(%d)\n", thread_current()->name, -1);
@@ -315,7 +365,7 @@ page_fault (struct intr_frame *f)
         printf("whatthe 2\n");
         return ; 
       }
-      fr_elem = malloc (sizeof(struct frame_elem));
+      fr_elem = frame_elem_alloc ();
       fr_elem->pd = tcurrent->pagedir;
       fr_elem->vaddr = upage;
       fr_elem->pd_thread = tcurrent;
@@ -344,13 +394,53 @@ page_fault (struct intr_frame *f)
       ASSERT (page_swap_out_index (upage, tcurrent, false, 0));
       swap_table_bitmap_set (swap_index, false);
 
-      fr_elem = malloc (sizeof(struct frame_elem));
+      fr_elem = frame_elem_alloc ();
       fr_elem->pd = tcurrent->pagedir;
       fr_elem->vaddr = upage;
       fr_elem->pd_thread = tcurrent;
       frame_table_push_back(fr_elem);
     }
   }
+  else if (write && writable && cow)
+  {
+    // fork 후 다른 프로세스와 함께 읽기 전용으로 map하던 frame에
+    // 처음 쓰는 경우. 아직 공유 중이면 미리 할당한 kpage에 복사해서
+    // 바꿔 끼우고, 이제 혼자 쓰고 있으면 쓰기만 허용한다.
+    swap_lock_acquire ();
+    uint8_t* old_kpage = pagedir_get_page (tcurrent->pagedir, upage);
+    faulted_page = page_lookup (upage, tcurrent);
+    // 그 사이 evict되었으면 아무것도 하지 않고 다시 fault하게 둔다.
+    if (old_kpage != NULL && faulted_page != NULL && faulted_page->cow)
+    {
+      if (frame_is_shared (old_kpage))
+      {
+        bool still_shared;
+        memcpy (kpage, old_kpage, PGSIZE);
+        // reverse map은 frame별로 있으므로 새 frame으로 옮긴다.
+        still_shared = frame_elem_remove (upage, tcurrent->pagedir);
+        pagedir_clear_page (tcurrent->pagedir, upage);
+        pagedir_set_page (tcurrent->pagedir, upage, kpage, true);
+        fr_elem = frame_elem_alloc ();
+        fr_elem->pd = tcurrent->pagedir;
+        fr_elem->vaddr = upage;
+        fr_elem->pd_thread = tcurrent;
+        frame_table_push_back(fr_elem);
+        if (upage == pg_round_down (tcurrent->user_esp))
+          pagedir_set_stack (tcurrent->pagedir, upage, true);
+        if (!still_shared)
+          palloc_free_page (old_kpage);
+        kpage = NULL;
+      }
+      else
+        pagedir_set_writable (tcurrent->pagedir, upage, true);
+      supplementary_lock_acquire (tcurrent);
+      faulted_page->cow = false;
+      supplementary_lock_release (tcurrent);
+    }
+    swap_lock_release ();
+    if (kpage != NULL)
+      palloc_free_page (kpage);
+  }
   else
   {
 #ifdef PRINT_PF
@@ -224,6 +224,20 @@ pagedir_is_writable (uint32_t *pd, const void *vpage)
   uint32_t *pte = lookup_page (pd, vpage, false);
   return pte != NULL && (*pte & PTE_W) != 0;
 }
+
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else 
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
 #endif
 
 /* Returns true if the PTE for virtual page VPAGE in PD has been
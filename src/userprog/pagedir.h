@@ -18,6 +18,7 @@ void pagedir_activate (uint32_t *pd);
 bool pagedir_is_stack (uint32_t *pd, const void *upage);
 void pagedir_set_stack (uint32_t *pd, const void *upage, bool dirty);
 bool pagedir_is_writable (uint32_t *pd, const void *upage);
+void pagedir_set_writable (uint32_t *pd, const void *upage, bool writable);
 #endif
 
 #endif /* userprog/pagedir.h */
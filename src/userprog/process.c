@@ -14,12 +14,23 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef PRJ3
+#include "vm/pagecache.h"
+#endif
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+#ifdef USERPROG
+static bool add_child (struct thread *, tid_t);
+#endif
+#ifdef PRJ3
+static thread_func start_fork NO_RETURN;
+static bool fork_files (struct thread *parent, struct thread *child);
+#endif
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -63,50 +74,57 @@ process_execute (const char *file_name)
   palloc_free_page (fn_copy);
   palloc_free_page (fn_copy2);
  
-  if (!tcurrent->child_success || tid == TID_ERROR)
+  if (!tcurrent->child_success || tid == TID_ERROR
+      || !add_child (tcurrent, tid))
   {
     lock_release (&tcurrent->child_list_lock);
     return -1;
   }
- 
+  lock_release (&tcurrent->child_list_lock);
+
+#else
+  /* Create a new thread to execute FILE_NAME. */
+  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
+  if (tid == TID_ERROR)
+    palloc_free_page (fn_copy);
+#endif
+  return tid;
+}
+
+#ifdef USERPROG
+/* 방금 만든 자식 TID를 T의 child_list에 넣는다. 자식의 thread는
+   T->ttmpchild로 넘어온다. T의 child_list_lock을 잡은 채로
+   불려야 한다. */
+static bool
+add_child (struct thread *t, tid_t tid)
+{
   // c_elem 를 여기서 지역변수로 선언하면 struct thread* 도중의 커널 스택 영역에 할당될 수 있어
   // 스택이 지나가면서 훼손될 우려가 있다. 따라서 별도의 페이지를 할당해서 만들어줘야 한다.
   struct child_elem* c_elem;
   c_elem = malloc (sizeof (struct child_elem));
   if (!c_elem)
-  {
-    lock_release (&tcurrent->child_list_lock);
-    return -1;
-  }
+    return false;
 
-  if (!tcurrent->ttmpchild) c_elem->tchild = NULL;
+  if (!t->ttmpchild) c_elem->tchild = NULL;
   else
   {
     c_elem->tchild = malloc (sizeof (struct thread*));
     if (!c_elem->tchild)
     {
-      lock_release (&tcurrent->child_list_lock);
       free (c_elem);
-      return -1;
+      return false;
     }
-    memcpy (&c_elem->tchild, &tcurrent->ttmpchild, sizeof (struct thread*));
-    tcurrent->ttmpchild = NULL;
+    memcpy (&c_elem->tchild, &t->ttmpchild, sizeof (struct thread*));
+    t->ttmpchild = NULL;
     ASSERT (c_elem->tchild->magic == 0xcd6abf4b);
   }
   c_elem->child_tid = tid;
   c_elem->exit_status = -1;
   sema_init(&c_elem->semaphore, 0);
-  list_push_back(&tcurrent->child_list, &c_elem->elem);
-  lock_release (&tcurrent->child_list_lock);
-
-#else
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
-  if (tid == TID_ERROR)
-    palloc_free_page (fn_copy);
-#endif
-  return tid;
+  list_push_back(&t->child_list, &c_elem->elem);
+  return true;
 }
+#endif
 
 /* A thread function that loads a user process and makes it start
    running. */
@@ -146,6 +164,148 @@ start_process (void *f_name)
   NOT_REACHED ();
 }
 
+#ifdef PRJ3
+/* Starts a new process that is a copy of the current one, and
+   returns its thread id to the caller, or -1 on failure.  The
+   child returns 0 from the same system call, described by F.
+   Its memory is not copied up front: pages in memory stay
+   mapped in both processes read-only and are copied by
+   page_fault() when either one writes (see page_fork()). */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct thread* tcurrent = thread_current();
+  tid_t tid;
+
+  tcurrent->child_success = false;
+  lock_acquire (&tcurrent->child_list_lock);
+  tid = thread_create (tcurrent->name, PRI_DEFAULT, start_fork, f);
+  if (tid != TID_ERROR)
+    sema_down(&tcurrent->creation_sema);
+
+  if (!tcurrent->child_success || tid == TID_ERROR
+      || !add_child (tcurrent, tid))
+  {
+    lock_release (&tcurrent->child_list_lock);
+    return -1;
+  }
+  lock_release (&tcurrent->child_list_lock);
+  return tid;
+}
+
+/* A thread function that copies the parent's address space and
+   open files and returns to user mode where the parent made the
+   fork system call.  The parent waits on its creation_sema, so
+   its intr_frame PARENT_IF and its tables stay put meanwhile. */
+static void
+start_fork (void *parent_if)
+{
+  struct thread* tcurrent = thread_current();
+  struct thread* tparent = tcurrent->tparent;
+  struct intr_frame if_;
+  bool success = false;
+
+  memcpy (&if_, parent_if, sizeof if_);
+  if_.eax = 0;
+
+  tcurrent->pagedir = pagedir_create ();
+  if (tcurrent->pagedir != NULL)
+  {
+    process_activate ();
+    supplementary_lock_acquire(tcurrent);
+    hash_init (&tcurrent->supplementary_page_table, page_hash, page_less, NULL);
+    supplementary_lock_release(tcurrent);
+    tcurrent->user_esp = tparent->user_esp;
+#ifdef PRJ4
+    tcurrent->current_dir = tparent->current_dir;
+#endif
+    success = fork_files (tparent, tcurrent)
+              && page_fork (tparent, tcurrent);
+  }
+
+  tparent->child_success = success;
+  tparent->ttmpchild = tcurrent;
+  sema_up(&tparent->creation_sema);
+
+  if (!success)
+    thread_exit ();
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Gives CHILD its own handles on PARENT's executable, open files
+   and mapped files, at the same positions. */
+static bool
+fork_files (struct thread *parent, struct thread *child)
+{
+  struct list_elem* elem_pointer;
+  int fd;
+
+  child->exec_file = file_reopen (parent->exec_file);
+  if (child->exec_file == NULL)
+    return false;
+  file_deny_write (child->exec_file);
+
+  lock_acquire (&parent->fd_table_lock);
+  child->fd_table = calloc (parent->fd_table_size, sizeof *child->fd_table);
+  if (child->fd_table == NULL && parent->fd_table_size > 0)
+  {
+    lock_release (&parent->fd_table_lock);
+    return false;
+  }
+  child->fd_table_size = parent->fd_table_size;
+  child->fd_free = parent->fd_free;
+  for (fd = 0; fd < parent->fd_table_size; fd++)
+  {
+    struct file_elem* fi = parent->fd_table[fd];
+    struct file_elem* fc;
+    if (fi == NULL)
+      continue;
+    fc = malloc (sizeof (struct file_elem));
+    if (fc == NULL)
+      break;
+    fc->f = file_reopen (fi->f);
+#ifdef PRJ4
+    fc->d = dir_reopen (fi->d);
+#endif
+    fc->fd = fd;
+    child->fd_table[fd] = fc;
+    if (fi->f != NULL && fc->f == NULL)
+      break;
+#ifdef PRJ4
+    if (fi->d != NULL && fc->d == NULL)
+      break;
+#endif
+    if (fc->f != NULL)
+      file_seek (fc->f, file_tell (fi->f));
+  }
+  lock_release (&parent->fd_table_lock);
+  if (fd < parent->fd_table_size)
+    return false;
+
+  child->next_mid = parent->next_mid;
+  elem_pointer = list_begin (&parent->mmap_list);
+  while (elem_pointer != list_end (&parent->mmap_list))
+  {
+    struct mmap_elem* mi = list_entry (elem_pointer, struct mmap_elem, elem);
+    struct mmap_elem* mc = malloc (sizeof (struct mmap_elem));
+    if (mc == NULL)
+      return false;
+    memcpy (mc, mi, sizeof *mc);
+    mc->f = file_reopen (mi->f);
+    if (mc->f == NULL)
+    {
+      free (mc);
+      return false;
+    }
+    list_push_back (&child->mmap_list, &mc->elem);
+    elem_pointer = list_next (elem_pointer);
+  }
+  return true;
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -229,6 +389,7 @@ process_kill (struct thread *ttarget)
   struct list_elem* elem_pointer = NULL;
   struct child_elem* i = NULL;
   struct file_elem* fi =NULL;
+  int fd;
 
   // 부모가 wait하고 있는 세마를 미리 찾아놓았다가 마지막에 sema_up
   if(ttarget->tparent->tid != ttarget->tid)
@@ -263,17 +424,23 @@ process_kill (struct thread *ttarget)
   lock_release(&ttarget->child_list_lock);
   lock_release_all (ttarget);
 
-  // struct thread의 file_list를 deallocate
-  lock_acquire (&ttarget->file_list_lock);
-  elem_pointer = list_begin(&(ttarget->file_list));
-  while (elem_pointer != list_end(&(ttarget->file_list)))
+  // struct thread의 fd_table을 deallocate
+  lock_acquire (&ttarget->fd_table_lock);
+  for (fd = 0; fd < ttarget->fd_table_size; fd++)
   {
-    fi = list_entry(elem_pointer , struct file_elem, elem);
+    fi = ttarget->fd_table[fd];
+    if (fi == NULL)
+      continue;
     file_close(fi->f);
-    elem_pointer = list_remove (elem_pointer);
+#ifdef PRJ4
+    dir_close (fi->d);
+#endif
     free (fi);
   }
-  lock_release (&ttarget->file_list_lock);
+  free (ttarget->fd_table);
+  ttarget->fd_table = NULL;
+  ttarget->fd_table_size = 0;
+  lock_release (&ttarget->fd_table_lock);
 
 #ifdef PRJ3
   /* mmap list 지움 */
@@ -287,11 +454,16 @@ process_kill (struct thread *ttarget)
   }
 #endif
 
+#ifndef PRJ3
   file_close (ttarget->exec_file);
-
-#ifdef PRJ3
+#else
   // frame_table에서 이 프로세스에 해당하는 frame_elem deallocate
-  frame_table_delete (ttarget->pagedir);
+  frame_table_delete (ttarget);
+
+  // page cache에서 공유하는 frame은 pagedir_destroy가 free하면
+  // 안 되므로 먼저 mapping을 끊는다. 실행 파일은 그 다음에 닫는다.
+  page_unmap_shared (ttarget);
+  file_close (ttarget->exec_file);
 
   // supplementary page table이 더 늦게 삭제되어야 한다.
   supplementary_lock_acquire(ttarget);
@@ -651,6 +823,8 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       pi->swap_index = 0;
       pi->f = file;
       pi->mmaped = false;
+      pi->shared = false;
+      pi->cow = false;
       supplementary_lock_acquire(tcurrent);
       hash_replace (&tcurrent->supplementary_page_table, &pi->elem);
       supplementary_lock_release(tcurrent);
@@ -700,6 +874,8 @@ setup_stack (void **esp)
 
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
 #ifdef PRJ3
+  if (kpage == NULL && pcache_reclaim ())
+    kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage == NULL)
   {
     // stack page할당이 실패하면 swap out해야함
@@ -707,22 +883,37 @@ setup_stack (void **esp)
     int count = 0;
     struct disk* d = disk_get(1,1);
     size_t swapping_index = swap_table_scan_and_flip();
-    struct frame_elem* victim_frame = frame_table_find_victim();
+    bool victim_mapped;
+    struct frame_elem* victim_frame = frame_table_find_victim (&victim_mapped);
     ASSERT(victim_frame != NULL);
   
+    struct page* victim_page = page_lookup (victim_frame->vaddr, victim_frame->pd_thread);
+    ASSERT (victim_page != NULL);
+  
     uint8_t* victim_kvaddr = pagedir_get_page(victim_frame->pd, victim_frame->vaddr);
     ASSERT(is_kernel_vaddr (victim_kvaddr));
 
-    ASSERT (page_swap_out_index (victim_frame->vaddr, victim_frame->pd_thread, true, swapping_index));
-    for (i = swapping_index*8; i<swapping_index*8+8; i++)
+    if (victim_page->shared)
     {
-      disk_write(d, i, victim_kvaddr + count*DISK_SECTOR_SIZE);
-      count++;
+      // page cache frame은 공유하는 모든 프로세스에서 unmap하고 free한다.
+      swap_table_unflip (swapping_index);
+      pcache_evict (victim_frame->pd, victim_frame->vaddr);
     }
+    else
+    {
+      ASSERT (page_swap_out_index (victim_frame->vaddr, victim_frame->pd_thread, true, swapping_index));
+      for (i = swapping_index*8; i<swapping_index*8+8; i++)
+      {
+        disk_write(d, i, victim_kvaddr + count*DISK_SECTOR_SIZE);
+        count++;
+      }
 
-    pagedir_clear_page(victim_frame->pd, victim_frame->vaddr);
-    palloc_free_page(victim_kvaddr);
-    free (victim_frame);
+      pagedir_clear_page(victim_frame->pd, victim_frame->vaddr);
+      // fork한 다른 프로세스가 아직 map하고 있으면 free하지 않는다.
+      if (!victim_mapped)
+        palloc_free_page(victim_kvaddr);
+    }
+    frame_elem_free (victim_frame);
 
     kpage = palloc_get_page (PAL_USER|PAL_ZERO);
     swap_lock_release ();
@@ -758,11 +949,13 @@ setup_stack (void **esp)
   pi->swap_index = 0;
   pi->f = NULL;
   pi->mmaped = false;
+  pi->shared = false;
+  pi->cow = false;
   supplementary_lock_acquire(tcurrent);
   hash_replace (&tcurrent->supplementary_page_table, &pi->elem);
   supplementary_lock_release(tcurrent);
 
-  struct frame_elem *fr_elem = malloc (sizeof(struct frame_elem));
+  struct frame_elem *fr_elem = frame_elem_alloc ();
   fr_elem->pd = tcurrent->pagedir;
   fr_elem->vaddr = ((uint8_t *) PHYS_BASE) - PGSIZE;
   fr_elem->pd_thread = tcurrent;
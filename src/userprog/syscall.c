@@ -3,9 +3,16 @@
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef PRJ4
+#include "filesys/directory.h"
+#include "filesys/journal.h"
+#include "filesys/super.h"
+#endif
 #ifdef USERPROG
 #include "threads/vaddr.h"
 bool check_valid_pointer (void* pointer, struct intr_frame* f);
+static bool check_iovec (const struct iovec *, int cnt, struct intr_frame *);
+static int do_iovec (int fd, const struct iovec *, int cnt, bool write);
 #endif
 
 static void syscall_handler (struct intr_frame *);
@@ -29,11 +36,7 @@ syscall_handler (struct intr_frame *f UNUSED)
   struct child_elem* t_elem;
   struct thread* tcurrent = thread_current();
 #ifdef PRJ4
-  char** ptpt;
-  disk_sector_t new_sector;
-  char *ret_ptr, *next_ptr;
   struct dir *dir;
-  struct inode *inode, *dummy_inode;
 #endif
 #ifdef PRJ3
   struct page* pi;
@@ -103,9 +106,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       // return 값은 eax로 넘겨준다.
       if(check_valid_pointer((void*)buffer, f) && check_valid_pointer(size, f))
       {
-        file_lock_acquire ();
         f->eax = filesys_create((const char*)buffer, (int) *size);
-        file_lock_release ();
       }
       else
       {
@@ -118,9 +119,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       buffer = (const char*)* ((int*)f->esp + 1);
       if(check_valid_pointer((void*) buffer, f))
       {
-        file_lock_acquire ();
         f->eax = filesys_remove ((const char*)buffer);
-        file_lock_release ();
       }
       else
       {
@@ -139,9 +138,7 @@ syscall_handler (struct intr_frame *f UNUSED)
           f->eax = -1;
           break;
         }
-        file_lock_acquire ();
         f_elem->f = filesys_open((const char*)buffer);
-        file_lock_release ();
 #ifdef PRJ4
         if (!f_elem->f) f_elem->d = NULL;
         else f_elem->d = dir_open (inode_reopen (file_get_inode (f_elem->f)));
@@ -151,15 +148,17 @@ syscall_handler (struct intr_frame *f UNUSED)
           free (f_elem);
           f->eax = -1;
         }
-        else
+        else if (add_file (f_elem) < 0)
         {
-          f_elem->fd = tcurrent->next_fd;
-          tcurrent->next_fd++;
-          lock_acquire (&tcurrent->file_list_lock);
-          list_push_back(&tcurrent->file_list, &f_elem->elem);
-          lock_release (&tcurrent->file_list_lock);
-          f->eax = f_elem->fd;
+          file_close (f_elem->f);
+#ifdef PRJ4
+          dir_close (f_elem->d);
+#endif
+          free (f_elem);
+          f->eax = -1;
         }
+        else
+          f->eax = f_elem->fd;
       }
       else
       {
@@ -246,6 +245,49 @@ syscall_handler (struct intr_frame *f UNUSED)
         thread_exit();
       }
       break;
+    case SYS_PREAD:
+    case SYS_PWRITE:
+      arg = (int*)f->esp + 1;  // fd
+      buffer = (const char*)* ((int*)f->esp + 2);
+      size = (int*)f->esp + 3; // length, then offset
+      if (check_valid_pointer (arg, f) && check_valid_pointer (size + 1, f)
+          && check_valid_pointer ((void*)buffer, f)
+          && (*size == 0
+              || check_valid_pointer ((void*)(buffer + *size - 1), f)))
+      {
+        // 파일 위치는 건드리지 않는다.
+        f_elem = find_file(*arg);
+        if (f_elem == NULL || *(size + 1) < 0)
+          f->eax = -1;
+        else if (syscall_no == SYS_PREAD)
+          f->eax = file_read_at (f_elem->f, (void*) buffer, *size,
+                                 *(size + 1));
+        else
+          f->eax = file_write_at (f_elem->f, buffer, *size, *(size + 1));
+      }
+      else
+      {
+        f->eax = -1;
+        printf("%s: exit(%d)\n", tcurrent->name, -1);
+        thread_exit();
+      }
+      break;
+    case SYS_READV:
+    case SYS_WRITEV:
+      arg = (int*)f->esp + 1;  // fd
+      buffer = (const char*)* ((int*)f->esp + 2); // iov
+      size = (int*)f->esp + 3; // iovcnt
+      if (check_valid_pointer (arg, f) && check_valid_pointer (size, f)
+          && check_iovec ((const struct iovec *) buffer, *size, f))
+        f->eax = do_iovec (*arg, (const struct iovec *) buffer, *size,
+                           syscall_no == SYS_WRITEV);
+      else
+      {
+        f->eax = -1;
+        printf("%s: exit(%d)\n", tcurrent->name, -1);
+        thread_exit();
+      }
+      break;
     case SYS_SEEK:
       arg = (int*)f->esp + 1; // fd
       size = (int*)f->esp + 2; //position
@@ -284,16 +326,13 @@ syscall_handler (struct intr_frame *f UNUSED)
       arg = (int*)f->esp + 1; // fd
       if(check_valid_pointer(arg, f))
       {
-        f_elem = find_file(*arg);
+        f_elem = remove_file (*arg);
         if(f_elem != NULL)
         {
-          file_lock_acquire ();
           file_close ((struct file*) f_elem->f);
 #ifdef PRJ4
           dir_close (f_elem->d);
 #endif
-          file_lock_release ();
-          list_remove(&f_elem->elem);
           free (f_elem);
         }
       }
@@ -373,6 +412,8 @@ syscall_handler (struct intr_frame *f UNUSED)
             pi->swap_index = 0;
             pi->f = mi->f;
             pi->mmaped = true;
+            pi->shared = false;
+            pi->cow = false;
             supplementary_lock_acquire(tcurrent);
             hash_replace (&tcurrent->supplementary_page_table, &pi->elem);
             supplementary_lock_release(tcurrent);
@@ -395,6 +436,9 @@ syscall_handler (struct intr_frame *f UNUSED)
         thread_exit();
       }
       break;
+    case SYS_FORK:
+      f->eax = process_fork (f);
+      break;
     case SYS_MUNMAP:
       arg = (int*)f->esp + 1;  // mapid_t
       if (check_valid_pointer (arg, f))
@@ -414,145 +458,22 @@ syscall_handler (struct intr_frame *f UNUSED)
 #ifdef PRJ4
     case SYS_CHDIR:
       buffer = (void*)* ((int*)f->esp + 1); // dir name
-
-      ret_ptr = palloc_get_page (PAL_ZERO);
-      ptpt = malloc (sizeof (char**));
-      memcpy (ptpt, &ret_ptr, sizeof (char**));
-      if (!ret_ptr)
-      {
-        printf("%s: exit(%d)\n", tcurrent->name, -1);
-        thread_exit();
-      }
-      strlcpy (ret_ptr, buffer, PGSIZE);
-
-      if (check_valid_pointer (buffer, f))
-      {
-        if (buffer[0] == '/') // absolute path
-          dir = dir_open_root ();
-        else // relative path
-          dir = dir_open (inode_open (tcurrent->current_dir));
-        if (dir == NULL)
-        {
-          palloc_free_page (*ptpt);
-          free (ptpt);
-          f->eax = false;
-          printf("%s: exit(%d)\n", tcurrent->name, -1);
-          thread_exit();
-        }
-
-        for (ret_ptr = strtok_r (ret_ptr, "/", &next_ptr);
-            ret_ptr != NULL;
-            ret_ptr = strtok_r (NULL, "/", &next_ptr))
-        {
-          if (!dir_lookup (dir, ret_ptr, &inode))
-          {
-            /* 중간인데 못찾으면 false return */
-            f->eax = false;
-            break;
-          }
-          dir_close (dir);
-          dir = dir_open (inode);
-          if (next_ptr[0] == '\0')
-          {
-            f->eax = true;
-            tcurrent->current_dir = \
-                inode_get_inumber (dir_get_inode (dir));
-          }
-        }
-        dir_close (dir);
-        palloc_free_page (*ptpt);
-        free (ptpt);
-      }
+      if (check_valid_pointer ((void*)buffer, f))
+        f->eax = filesys_chdir (buffer);
       else
       {
         f->eax = false;
-        palloc_free_page (*ptpt);
-        free (ptpt);
         printf("%s: exit(%d)\n", tcurrent->name, -1);
         thread_exit();
       }
       break;
     case SYS_MKDIR:
       buffer = (void*)* ((int*)f->esp + 1); // dir name
-
-      ret_ptr = palloc_get_page (PAL_ZERO);
-      ptpt = malloc (sizeof (char**));
-      memcpy (ptpt, &ret_ptr, sizeof (char**));
-      if (!ret_ptr)
-      {
-        printf("%s: exit(%d)\n", tcurrent->name, -1);
-        thread_exit();
-      }
-      strlcpy (ret_ptr, buffer, PGSIZE);
-
-      if (check_valid_pointer (buffer, f))
-      {
-        if (buffer[0] == '/') // absolute path
-        {
-          inode = inode_open (ROOT_DIR_SECTOR);
-          dir = dir_open (inode);
-        }
-        else // relative path
-        {
-          inode = inode_open (tcurrent->current_dir);
-          dir = dir_open (inode);
-        }
-        if (dir == NULL)
-        {
-          f->eax = false;
-          palloc_free_page (*ptpt);
-          free (ptpt);
-          printf("%s: exit(%d)\n", tcurrent->name, -1);
-          thread_exit();
-        }
-        f->eax = false;
-
-        for (ret_ptr = strtok_r (ret_ptr, "/", &next_ptr);
-            ret_ptr != NULL;
-            ret_ptr = strtok_r (NULL, "/", &next_ptr))
-        {
-          if (next_ptr[0] != '\0')
-          {
-            if (!dir_lookup (dir, ret_ptr, &inode))
-            {
-              /* 중간인데 못찾으면 false return */
-              f->eax = false;
-              break;
-            }
-            dir_close (dir);
-            dir = dir_open (inode);
-          }
-          if (next_ptr[0] == '\0')
-          {
-            if (dir_lookup (dir, ret_ptr, &dummy_inode))
-              /* 마지막인데 이미 존재한 경우 return false */
-              f->eax = false;
-            else
-            {
-              if (!free_map_allocate (1, &new_sector))
-              {
-                f->eax = false;
-                break;
-              }
-              if (!dir_create (new_sector, inode_get_inumber (inode), 16))
-              {
-                f->eax = false;
-                break;
-              }
-              dir_add (dir, ret_ptr, new_sector);
-              f->eax = true;
-            }
-          }
-        }
-        palloc_free_page (*ptpt);
-        free (ptpt);
-        dir_close (dir);
-      }
+      if (check_valid_pointer ((void*)buffer, f))
+        f->eax = filesys_mkdir (buffer);
       else
       {
         f->eax = false;
-        palloc_free_page (*ptpt);
-        free (ptpt);
         printf("%s: exit(%d)\n", tcurrent->name, -1);
         thread_exit();
       }
@@ -574,7 +495,7 @@ syscall_handler (struct intr_frame *f UNUSED)
             thread_exit();
           }
 
-          f->eax = dir_readdir (dir, buffer);
+          f->eax = dir_readdir (dir, (char *) buffer);
           dir = NULL;
         }
         else f->eax = false;
@@ -586,6 +507,28 @@ syscall_handler (struct intr_frame *f UNUSED)
         thread_exit();
       }
       break;
+    case SYS_GETDENTS:
+      arg = (int*)f->esp + 1;  // fd
+      buffer = (void*)* ((int*)f->esp + 2); // entries
+      size = (int*)f->esp + 3;
+      if (check_valid_pointer (arg, f) && check_valid_pointer (size, f)
+          && check_valid_pointer ((void*)buffer, f)
+          && (*size == 0
+              || check_valid_pointer ((void*)(buffer + *size - 1), f)))
+      {
+        f_elem = find_file(*arg);
+        if (f_elem != NULL && f_elem->d != NULL)
+          f->eax = dir_getdents (f_elem->d, (struct dirent *) buffer,
+                                 (unsigned) *size / sizeof (struct dirent));
+        else f->eax = -1;
+      }
+      else
+      {
+        f->eax = -1;
+        printf("%s: exit(%d)\n", tcurrent->name, -1);
+        thread_exit();
+      }
+      break;
     case SYS_ISDIR:
       arg = (int*)f->esp + 1;  // fd
       if (check_valid_pointer (arg, f))
@@ -622,6 +565,86 @@ syscall_handler (struct intr_frame *f UNUSED)
         thread_exit();
       }
       break;
+    case SYS_FALLOCATE:
+      arg = (int*)f->esp + 1;  // fd
+      size = (int*)f->esp + 3; // length, after offset
+      if (check_valid_pointer (arg, f) && check_valid_pointer (size, f))
+      {
+        f_elem = find_file(*arg);
+        if (f_elem != NULL
+            && !inode_is_directory (file_get_inode (f_elem->f)))
+          f->eax = inode_fallocate (file_get_inode (f_elem->f),
+                                    (off_t) *(arg + 1), (off_t) *size);
+        else f->eax = false;
+      }
+      else
+      {
+        f->eax = -1;
+        printf("%s: exit(%d)\n", tcurrent->name, -1);
+        thread_exit();
+      }
+      break;
+    case SYS_COPY_FILE_RANGE:
+      arg = (int*)f->esp + 1;  // in_fd
+      size = (int*)f->esp + 3; // length, after out_fd
+      if (check_valid_pointer (arg, f) && check_valid_pointer (size, f))
+      {
+        struct file_elem *out_elem = find_file (*(arg + 1));
+        f_elem = find_file(*arg);
+        if (f_elem != NULL && out_elem != NULL)
+          f->eax = file_copy (out_elem->f, f_elem->f, (off_t) *size);
+        else f->eax = -1;
+      }
+      else
+      {
+        f->eax = -1;
+        printf("%s: exit(%d)\n", tcurrent->name, -1);
+        thread_exit();
+      }
+      break;
+    case SYS_FSYNC:
+      arg = (int*)f->esp + 1; // fd
+      if (check_valid_pointer (arg, f))
+      {
+        f_elem = find_file(*arg);
+        if (f_elem != NULL)
+        {
+          file_sync (f_elem->f);
+          f->eax = 0;
+        }
+        else f->eax = -1;
+      }
+      else
+      {
+        f->eax = -1;
+        printf("%s: exit(%d)\n", tcurrent->name, -1);
+        thread_exit();
+      }
+      break;
+    case SYS_SYNC:
+      journal_commit ();
+      break;
+    case SYS_STATFS:
+      buffer = (void*)* ((int*)f->esp + 1); // buf
+      if (check_valid_pointer ((int*)f->esp + 1, f)
+          && check_valid_pointer ((void*)buffer, f)
+          && check_valid_pointer ((void*)(buffer + sizeof (struct statfs) - 1),
+                                  f))
+      {
+        struct statfs *st = (struct statfs *) buffer;
+        st->block_size = DISK_SECTOR_SIZE;
+        st->block_cnt = disk_size (filesys_disk);
+        st->free_cnt = super_free_cnt ();
+        st->inode_cnt = super_inode_cnt ();
+        f->eax = true;
+      }
+      else
+      {
+        f->eax = -1;
+        printf("%s: exit(%d)\n", tcurrent->name, -1);
+        thread_exit();
+      }
+      break;
 #endif
     default:
       printf ("system call!\n");
@@ -654,4 +677,66 @@ check_valid_pointer (void* pointer, struct intr_frame* f)
 
   return true;
 }
+
+/* Checks the CNT buffers in IOV, and IOV itself, the way
+   check_valid_pointer() checks a single buffer.  A bad CNT is
+   left for do_iovec() to refuse. */
+static bool
+check_iovec (const struct iovec *iov, int cnt, struct intr_frame *f)
+{
+  int i;
+
+  if (cnt <= 0 || cnt > IOV_MAX)
+    return true;
+  if (!check_valid_pointer ((void *) iov, f)
+      || !check_valid_pointer ((void *) (iov + cnt) - 1, f))
+    return false;
+  for (i = 0; i < cnt; i++)
+    if (iov[i].iov_len > 0
+        && (!check_valid_pointer (iov[i].iov_base, f)
+            || !check_valid_pointer ((char *) iov[i].iov_base
+                                     + iov[i].iov_len - 1, f)))
+      return false;
+  return true;
+}
+
+/* Reads into, or if WRITE is true writes from, the CNT buffers
+   in IOV in order, starting at the current position of FD.
+   Stops at the first short transfer.  Returns the number of
+   bytes transferred, or -1 if nothing could be. */
+static int
+do_iovec (int fd, const struct iovec *iov, int cnt, bool write)
+{
+  struct file_elem *f_elem;
+  int total = 0;
+  int i;
+
+  if (cnt <= 0 || cnt > IOV_MAX)
+    return -1;
+  if (write && fd == 1)
+  {
+    for (i = 0; i < cnt; i++)
+    {
+      putbuf (iov[i].iov_base, iov[i].iov_len);
+      total += iov[i].iov_len;
+    }
+    return total;
+  }
+
+  f_elem = find_file (fd);
+  if (f_elem == NULL)
+    return -1;
+  for (i = 0; i < cnt; i++)
+  {
+    off_t bytes = (write
+                   ? file_write (f_elem->f, iov[i].iov_base, iov[i].iov_len)
+                   : file_read (f_elem->f, iov[i].iov_base, iov[i].iov_len));
+    if (bytes < 0)
+      return total > 0 ? total : -1;
+    total += bytes;
+    if ((unsigned) bytes != iov[i].iov_len)
+      break;
+  }
+  return total;
+}
 #endif
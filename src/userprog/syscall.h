@@ -9,12 +9,32 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "devices/input.h"
-void file_lock_init(void);
 #endif
 #ifdef PRJ3
 #include "vm/page.h"
 #endif
 
+/* One buffer for readv() or writev().
+   Must match struct iovec in lib/user/syscall.h. */
+struct iovec
+  {
+    void *iov_base;                     /* Start of buffer. */
+    unsigned iov_len;                   /* Size of buffer in bytes. */
+  };
+
+/* Most buffers one readv() or writev() call takes. */
+#define IOV_MAX 64
+
+/* File system usage written by statfs().
+   Must match struct statfs in lib/user/syscall.h. */
+struct statfs
+  {
+    unsigned block_size;                /* Bytes in a block. */
+    unsigned block_cnt;                 /* Blocks on the disk. */
+    unsigned free_cnt;                  /* Free blocks. */
+    unsigned inode_cnt;                 /* Inodes in use. */
+  };
+
 void syscall_init (void);
 
 #endif /* userprog/syscall.h */
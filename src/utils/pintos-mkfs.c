@@ -0,0 +1,530 @@
+/* Formats a Pintos file system disk on the host and fills it
+   with the files and directories under a host directory, so
+   that Pintos can mount it without -f or any `put's.
+
+   The image is in the format the filesys project writes: chained
+   inodes with inline data for small files, compact directories,
+   the free map file, a superblock marked clean and an empty
+   journal.  The structures below must match the ones in
+   filesys/ of the kernel, and the host must be little-endian,
+   as the kernel is. */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DISK_SECTOR_SIZE 512
+typedef uint32_t disk_sector_t;
+
+#define DIV_ROUND_UP(X, STEP) (((X) + (STEP) - 1) / (STEP))
+#define ROUND_UP(X, STEP) (DIV_ROUND_UP (X, STEP) * (STEP))
+
+/* filesys/filesys.h, filesys/journal.h, filesys/cache.h. */
+#define FREE_MAP_SECTOR 0
+#define ROOT_DIR_SECTOR 1
+#define SUPERBLOCK_SECTOR 2
+#define JOURNAL_SECTOR (SUPERBLOCK_SECTOR + 1)
+#define JOURNAL_BLOCKS 64               /* BUFFER_CACHE_SIZE. */
+#define JOURNAL_SECTORS (1 + JOURNAL_BLOCKS)
+
+/* filesys/inode.c. */
+#define INODE_MAGIC 0x494e4f44
+#define INODE_INLINE 0x80000000
+#define INODE_DIR_COMPACT 0x20000000
+#define DIRECT_NO 123
+#define INODE_INLINE_MAX (DIRECT_NO * sizeof (int32_t))
+#define DIR_LEVEL_MAX 213
+
+struct inode_disk
+  {
+    disk_sector_t sector;
+    uint32_t info;
+    int32_t length;
+    int32_t direct[DIRECT_NO];
+    int32_t indirect;
+    uint32_t magic;
+  };
+
+/* filesys/directory.c and filesys/directory.h. */
+#define FS_NAME_MAX 14
+
+struct dir_record
+  {
+    disk_sector_t inode_sector;
+    uint16_t rec_len;
+    uint8_t name_len;
+    uint8_t is_dir;
+  };
+
+#define REC_SIZE(NAME_LEN) \
+        ROUND_UP (sizeof (struct dir_record) + (NAME_LEN), 4)
+
+/* filesys/super.c. */
+#define SUPER_MAGIC 0x53555052
+#define SUPER_VERSION 1
+#define SUPER_GROUP_SECTORS (DISK_SECTOR_SIZE * 8)
+#define SUPER_GROUPS_MAX 240
+
+struct superblock
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t clean;
+    uint32_t sector_cnt;
+    uint32_t free_cnt;
+    uint32_t inode_cnt;
+    uint32_t group_cnt;
+    uint16_t group_free[SUPER_GROUPS_MAX];
+    uint8_t unused[DISK_SECTOR_SIZE - 7 * sizeof (uint32_t)
+                   - SUPER_GROUPS_MAX * sizeof (uint16_t)];
+  };
+
+/* filesys/journal.c. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+struct journal_record
+  {
+    uint32_t magic;
+    uint32_t cnt;
+    disk_sector_t sectors[JOURNAL_BLOCKS];
+    uint8_t unused[DISK_SECTOR_SIZE - 2 * sizeof (uint32_t)
+                   - JOURNAL_BLOCKS * sizeof (disk_sector_t)];
+  };
+
+static const char *program_name;
+static const char *disk_name;
+static int disk_fd;
+static disk_sector_t sector_cnt;        /* Sectors on the disk. */
+static uint8_t *free_map;               /* One bit per sector, set if used. */
+static disk_sector_t next_free;         /* No free sector before this. */
+static uint32_t inode_cnt;              /* Inodes written. */
+
+static void fail (const char *, ...)
+  __attribute__ ((noreturn, format (printf, 1, 2)));
+
+/* Prints an error message and exits. */
+static void
+fail (const char *format, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s: ", program_name);
+  va_start (args, format);
+  vfprintf (stderr, format, args);
+  va_end (args);
+  putc ('\n', stderr);
+  exit (EXIT_FAILURE);
+}
+
+/* Writes DISK_SECTOR_SIZE bytes from BUFFER to SECTOR. */
+static void
+write_sector (disk_sector_t sector, const void *buffer)
+{
+  if (pwrite (disk_fd, buffer, DISK_SECTOR_SIZE,
+              (off_t) sector * DISK_SECTOR_SIZE) != DISK_SECTOR_SIZE)
+    fail ("%s: write: %s", disk_name, strerror (errno));
+}
+
+/* Reads SECTOR into BUFFER. */
+static void
+read_sector (disk_sector_t sector, void *buffer)
+{
+  if (pread (disk_fd, buffer, DISK_SECTOR_SIZE,
+             (off_t) sector * DISK_SECTOR_SIZE) != DISK_SECTOR_SIZE)
+    fail ("%s: read: %s", disk_name, strerror (errno));
+}
+
+/* Marks SECTOR used. */
+static void
+mark_sector (disk_sector_t sector)
+{
+  free_map[sector / 8] |= 1 << (sector % 8);
+}
+
+/* Returns true if SECTOR is used. */
+static bool
+test_sector (disk_sector_t sector)
+{
+  return (free_map[sector / 8] >> (sector % 8)) & 1;
+}
+
+/* Allocates and returns the first free sector.  Sectors are
+   handed out in order, so each file's data ends up contiguous. */
+static disk_sector_t
+allocate_sector (void)
+{
+  while (next_free < sector_cnt && test_sector (next_free))
+    next_free++;
+  if (next_free >= sector_cnt)
+    fail ("%s: disk is full", disk_name);
+  mark_sector (next_free);
+  return next_free++;
+}
+
+/* Writes an inode to SECTOR for LENGTH bytes of DATA, which may
+   be a null pointer for all zeros, with the given INFO flags.
+   Files of up to INODE_INLINE_MAX bytes keep their data inline
+   unless INLINE_OK is false. */
+static void
+write_inode (disk_sector_t sector, uint32_t info, const uint8_t *data,
+             size_t length, bool inline_ok)
+{
+  struct inode_disk head, link;
+  struct inode_disk *tail = &head;
+  static const uint8_t zeros[DISK_SECTOR_SIZE];
+  size_t i, slot = 0;
+
+  memset (&head, 0, sizeof head);
+  head.sector = sector;
+  head.info = info;
+  head.length = length;
+  head.magic = INODE_MAGIC;
+  inode_cnt++;
+
+  if (inline_ok && length <= INODE_INLINE_MAX)
+    {
+      head.info |= INODE_INLINE;
+      if (data != NULL)
+        memcpy (head.direct, data, length);
+      write_sector (sector, &head);
+      return;
+    }
+
+  for (i = 0; i < DIV_ROUND_UP (length, DISK_SECTOR_SIZE); i++)
+    {
+      uint8_t buffer[DISK_SECTOR_SIZE];
+      size_t ofs = i * DISK_SECTOR_SIZE;
+      size_t chunk = length - ofs < DISK_SECTOR_SIZE
+                     ? length - ofs : DISK_SECTOR_SIZE;
+      disk_sector_t data_sector;
+
+      if (slot == DIRECT_NO)
+        {
+          /* This link is full, so start a fresh one after it. */
+          disk_sector_t next = allocate_sector ();
+
+          tail->indirect = next;
+          write_sector (tail->sector, tail);
+          memset (&link, 0, sizeof link);
+          link.sector = next;
+          link.info = info & ~INODE_DIR_COMPACT;
+          link.magic = INODE_MAGIC;
+          tail = &link;
+          slot = 0;
+        }
+      data_sector = allocate_sector ();
+      if (data != NULL)
+        {
+          memcpy (buffer, data + ofs, chunk);
+          memset (buffer + chunk, 0, DISK_SECTOR_SIZE - chunk);
+          write_sector (data_sector, buffer);
+        }
+      else
+        write_sector (data_sector, zeros);
+      tail->direct[slot++] = data_sector;
+    }
+  write_sector (tail->sector, tail);
+}
+
+/* Overwrites the data of the inode at SECTOR, which was written
+   by write_inode() with the same LENGTH, with DATA. */
+static void
+rewrite_inode_data (disk_sector_t sector, const uint8_t *data,
+                    size_t length)
+{
+  struct inode_disk link;
+  size_t i;
+
+  read_sector (sector, &link);
+  if (link.info & INODE_INLINE)
+    {
+      memcpy (link.direct, data, length);
+      write_sector (sector, &link);
+      return;
+    }
+  for (i = 0; i * DISK_SECTOR_SIZE < length; i++)
+    {
+      uint8_t buffer[DISK_SECTOR_SIZE];
+      size_t ofs = i * DISK_SECTOR_SIZE;
+      size_t chunk = length - ofs < DISK_SECTOR_SIZE
+                     ? length - ofs : DISK_SECTOR_SIZE;
+
+      if (i > 0 && i % DIRECT_NO == 0)
+        read_sector (link.indirect, &link);
+      memcpy (buffer, data + ofs, chunk);
+      memset (buffer + chunk, 0, DISK_SECTOR_SIZE - chunk);
+      write_sector (link.direct[i % DIRECT_NO], buffer);
+    }
+}
+
+/* A compact directory's content while it is being built. */
+struct dir_buffer
+  {
+    uint8_t *data;                      /* Records. */
+    size_t length;                      /* Bytes in DATA. */
+    size_t last;                        /* Offset of the last record. */
+  };
+
+/* Returns the bytes a record at OFS with a NAME_LEN-byte name
+   needs, counting the index sector kept by the "." record. */
+static size_t
+record_size (size_t name_len, size_t ofs)
+{
+  return REC_SIZE (name_len) + (ofs == 0 ? sizeof (disk_sector_t) : 0);
+}
+
+/* Appends a record for NAME, with inode SECTOR, to DIR.  The
+   record goes in the slack after the last one if it fits, and
+   into a new sector otherwise, as dir_add() would put it. */
+static void
+add_record (struct dir_buffer *dir, const char *name, disk_sector_t sector,
+            bool is_dir)
+{
+  size_t len = strlen (name);
+  struct dir_record *r;
+  size_t ofs = dir->length;
+
+  if (dir->length > 0)
+    {
+      struct dir_record *last = (struct dir_record *) (dir->data + dir->last);
+      size_t used = record_size (last->name_len, dir->last);
+
+      ofs = dir->last + used;
+      if (last->rec_len - used >= record_size (len, ofs))
+        last->rec_len = used;
+      else
+        ofs = dir->length;
+    }
+  if (ofs == dir->length)
+    {
+      dir->data = realloc (dir->data, dir->length + DISK_SECTOR_SIZE);
+      if (dir->data == NULL)
+        fail ("out of memory");
+      memset (dir->data + dir->length, 0, DISK_SECTOR_SIZE);
+      dir->length += DISK_SECTOR_SIZE;
+    }
+
+  r = (struct dir_record *) (dir->data + ofs);
+  r->inode_sector = sector;
+  r->rec_len = ROUND_UP (ofs + 1, DISK_SECTOR_SIZE) - ofs;
+  r->name_len = len;
+  r->is_dir = is_dir;
+  memcpy (r + 1, name, len);
+  dir->last = ofs;
+}
+
+/* Compares directory entry names, for qsort(). */
+static int
+compare_names (const void *a_, const void *b_)
+{
+  const char *const *a = a_;
+  const char *const *b = b_;
+  return strcmp (*a, *b);
+}
+
+/* Reads host file PATH into a new buffer and stores its size in
+   *LENGTH. */
+static uint8_t *
+read_host_file (const char *path, size_t *length)
+{
+  uint8_t *data;
+  struct stat st;
+  int fd = open (path, O_RDONLY);
+
+  if (fd < 0 || fstat (fd, &st) < 0)
+    fail ("%s: %s", path, strerror (errno));
+  if (st.st_size > INT32_MAX)
+    fail ("%s: file is too large", path);
+  *length = st.st_size;
+  data = malloc (*length + 1);
+  if (data == NULL)
+    fail ("out of memory");
+  if (read (fd, data, *length) != (ssize_t) *length)
+    fail ("%s: read: %s", path, strerror (errno));
+  close (fd);
+  return data;
+}
+
+/* Writes the directory at SECTOR, with parent PARENT and depth
+   LEVEL, holding everything in host directory PATH.  If PATH is
+   a null pointer, the directory is empty. */
+static void
+build_dir (disk_sector_t sector, disk_sector_t parent, uint32_t level,
+           const char *path)
+{
+  struct dir_buffer dir = {NULL, 0, 0};
+  char **names = NULL;
+  size_t name_cnt = 0, i;
+
+  if (level > DIR_LEVEL_MAX)
+    fail ("%s: directories nested too deeply", path);
+
+  add_record (&dir, ".", sector, true);
+  add_record (&dir, "..", parent, true);
+
+  if (path != NULL)
+    {
+      struct dirent *de;
+      DIR *host_dir = opendir (path);
+
+      if (host_dir == NULL)
+        fail ("%s: %s", path, strerror (errno));
+      while ((de = readdir (host_dir)) != NULL)
+        {
+          if (!strcmp (de->d_name, ".") || !strcmp (de->d_name, ".."))
+            continue;
+          names = realloc (names, (name_cnt + 1) * sizeof *names);
+          if (names == NULL || (names[name_cnt] = strdup (de->d_name)) == NULL)
+            fail ("out of memory");
+          name_cnt++;
+        }
+      closedir (host_dir);
+      qsort (names, name_cnt, sizeof *names, compare_names);
+    }
+
+  for (i = 0; i < name_cnt; i++)
+    {
+      char *child_path = malloc (strlen (path) + strlen (names[i]) + 2);
+      disk_sector_t child;
+      struct stat st;
+
+      if (child_path == NULL)
+        fail ("out of memory");
+      sprintf (child_path, "%s/%s", path, names[i]);
+      if (stat (child_path, &st) < 0)
+        fail ("%s: %s", child_path, strerror (errno));
+      if (!S_ISDIR (st.st_mode) && !S_ISREG (st.st_mode))
+        {
+          fprintf (stderr, "%s: %s: skipping, not a file or directory\n",
+                   program_name, child_path);
+          free (child_path);
+          continue;
+        }
+      if (strlen (names[i]) > FS_NAME_MAX)
+        fail ("%s: name longer than %d characters", child_path, FS_NAME_MAX);
+
+      child = allocate_sector ();
+      if (S_ISDIR (st.st_mode))
+        build_dir (child, sector, level + 1, child_path);
+      else
+        {
+          size_t length;
+          uint8_t *data = read_host_file (child_path, &length);
+          write_inode (child, 0, data, length, true);
+          free (data);
+        }
+      add_record (&dir, names[i], child, S_ISDIR (st.st_mode));
+      free (child_path);
+      free (names[i]);
+    }
+  free (names);
+
+  write_inode (sector, 1 | (level << 1) | INODE_DIR_COMPACT, dir.data,
+               dir.length, false);
+  free (dir.data);
+}
+
+/* Writes the superblock, marked clean, with counts taken from
+   the free map. */
+static void
+write_superblock (void)
+{
+  struct superblock sb;
+  disk_sector_t sector;
+
+  memset (&sb, 0, sizeof sb);
+  sb.magic = SUPER_MAGIC;
+  sb.version = SUPER_VERSION;
+  sb.clean = 1;
+  sb.sector_cnt = sector_cnt;
+  sb.inode_cnt = inode_cnt;
+  sb.group_cnt = DIV_ROUND_UP (sector_cnt, SUPER_GROUP_SECTORS);
+  for (sector = 0; sector < sector_cnt; sector++)
+    if (!test_sector (sector))
+      {
+        sb.free_cnt++;
+        sb.group_free[sector / SUPER_GROUP_SECTORS]++;
+      }
+  write_sector (SUPERBLOCK_SECTOR, &sb);
+}
+
+/* Writes an empty journal. */
+static void
+write_journal (void)
+{
+  struct journal_record record;
+
+  memset (&record, 0, sizeof record);
+  record.magic = JOURNAL_MAGIC;
+  write_sector (JOURNAL_SECTOR, &record);
+}
+
+static void
+usage (void)
+{
+  printf ("pintos-mkfs, a utility for formatting Pintos file system disks\n"
+          "Usage: %s DISKFILE [DIRECTORY]\n"
+          "where DISKFILE is an existing disk, e.g. from pintos-mkdisk,\n"
+          "  to format, and DIRECTORY is a host directory whose files\n"
+          "  and subdirectories are copied into the new file system.\n"
+          "Boot Pintos on the disk without -f.\n",
+          program_name);
+}
+
+int
+main (int argc, char *argv[])
+{
+  size_t free_map_size;
+  disk_sector_t sector;
+  struct stat st;
+
+  program_name = argv[0];
+  if (argc < 2 || argc > 3 || argv[1][0] == '-')
+    {
+      usage ();
+      return argc == 2 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  disk_name = argv[1];
+
+  disk_fd = open (disk_name, O_RDWR);
+  if (disk_fd < 0 || fstat (disk_fd, &st) < 0)
+    fail ("%s: %s", disk_name, strerror (errno));
+  sector_cnt = st.st_size / DISK_SECTOR_SIZE;
+  if (sector_cnt < JOURNAL_SECTOR + JOURNAL_SECTORS + 16)
+    fail ("%s: disk is too small", disk_name);
+  if (DIV_ROUND_UP (sector_cnt, SUPER_GROUP_SECTORS) > SUPER_GROUPS_MAX)
+    fail ("%s: disk is too large", disk_name);
+
+  /* The free map is stored as 32-bit words, as in lib/kernel/bitmap.c. */
+  free_map_size = DIV_ROUND_UP (sector_cnt, 32) * 4;
+  free_map = calloc (1, free_map_size);
+  if (free_map == NULL)
+    fail ("out of memory");
+  mark_sector (FREE_MAP_SECTOR);
+  mark_sector (ROOT_DIR_SECTOR);
+  mark_sector (SUPERBLOCK_SECTOR);
+  for (sector = JOURNAL_SECTOR; sector < JOURNAL_SECTOR + JOURNAL_SECTORS;
+       sector++)
+    mark_sector (sector);
+
+  /* Same order as do_format(): the free map file first, then the
+     root directory and everything under it, and last the free
+     map's contents, once nothing more will be allocated. */
+  write_inode (FREE_MAP_SECTOR, 0, NULL, free_map_size, true);
+  build_dir (ROOT_DIR_SECTOR, ROOT_DIR_SECTOR, 0, argc > 2 ? argv[2] : NULL);
+  rewrite_inode_data (FREE_MAP_SECTOR, free_map, free_map_size);
+  write_superblock ();
+  write_journal ();
+
+  if (close (disk_fd) < 0)
+    fail ("%s: close: %s", disk_name, strerror (errno));
+  return EXIT_SUCCESS;
+}
@@ -1,5 +1,13 @@
 #include "vm/page.h"
 #ifdef PRJ3
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "userprog/pagedir.h"
+#include "vm/pagecache.h"
 
 unsigned
 page_hash (const struct hash_elem *p_, void *aux UNUSED)
@@ -18,65 +26,88 @@ page_less (const struct hash_elem *a_, const struct hash_elem *b_,
   return a->load_vaddr < b->load_vaddr;
 }
 
+/* page_print_stats()가 출력하는 통계. 모든 프로세스가 함께
+ * 쓰므로 interrupt를 끄고 센다. */
+static long long page_lookup_cnt;       /* page_lookup() 호출 수. */
+static long long page_update_cnt;       /* page_swap_out_index() 호출 수. */
+static long long page_alloc_cnt;        /* page fault 중의 heap 할당 수. */
+
+static void
+page_count (long long *cnt)
+{
+  enum intr_level old_level = intr_disable ();
+  (*cnt)++;
+  intr_set_level (old_level);
+}
+
+/* page fault를 처리하면서 필요한 메모리를 malloc()으로 할당하고
+ * 그 횟수를 센다. page fault 경로의 할당은 모두 이것을 거친다. */
+void *
+page_fault_malloc (size_t size)
+{
+  page_count (&page_alloc_cnt);
+  return malloc (size);
+}
+
+/* T의 supplementary page table에서 ADDRESS를 포함하는 page를
+ * 찾는다. T의 supplementary lock을 잡은 채로 불려야 한다. */
+static struct page *
+page_find (const void *address, struct thread* t)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.load_vaddr = (uint32_t) pg_round_down (address);
+  e = hash_find (&t->supplementary_page_table, &key.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
 /* Returns the page containing the given virtual address,
  * or a null pointer if no such page exists. */
 struct page *
 page_lookup (const void *address, struct thread* tcurrent)
 {
+  struct page *p;
+
   ASSERT (tcurrent != NULL && tcurrent->magic == 0xcd6abf4b);
   supplementary_lock_acquire(tcurrent);
-  struct page *p = malloc (sizeof(struct page));
-  struct hash_elem *e;
-  if (p == NULL)
-  {
-    supplementary_lock_release (tcurrent);
-    return NULL;
-  }
-  p->load_vaddr = pg_round_down(address);
-  e = hash_find (&tcurrent->supplementary_page_table, &p->elem);
-  struct page* ans = e != NULL ?  hash_entry (e, struct page, elem) : NULL;
+  page_count (&page_lookup_cnt);
+  p = page_find (address, tcurrent);
   supplementary_lock_release(tcurrent);
-  free(p);
-  return ans;
+  return p;
 }
 
+/* ADDRESS를 포함하는 page의 swap 상태를 그 자리에서 바꾼다.
+ * page를 새로 만들지 않으므로 page_lookup()으로 얻은 pointer는
+ * 계속 쓸 수 있다. 그런 page가 없으면 false. */
 bool
 page_swap_out_index (const void *address, struct thread* tcurrent, bool new_swap_outed, uint32_t new_index)
 {
+  struct page *p;
+
   ASSERT (tcurrent != NULL && tcurrent->magic == 0xcd6abf4b);
   ASSERT (!hash_empty (&tcurrent->supplementary_page_table));
   supplementary_lock_acquire(tcurrent);
-  struct page *p = malloc (sizeof(struct page));
-  struct hash_elem *e;
-  if (p == NULL)
-  {
-    supplementary_lock_release (tcurrent);
-    return false;
-  }
-  p->load_vaddr = pg_round_down(address);
-  e = hash_find (&tcurrent->supplementary_page_table, &p->elem);
-  struct page* prev_p = e != NULL ?  hash_entry (e, struct page, elem) : NULL;
-  if (prev_p)
+  page_count (&page_update_cnt);
+  p = page_find (address, tcurrent);
+  if (p != NULL)
   {
-    p->load_filepos = prev_p->load_filepos;
-    p->load_read_bytes = prev_p->load_read_bytes;
-    p->load_zero_bytes = prev_p->load_zero_bytes;
-    p->writable = prev_p->writable;
     p->swap_outed = new_swap_outed;
     p->swap_index = new_index;
-    p->f = prev_p->f;
-    p->mmaped = prev_p->mmaped;
-    hash_replace (&tcurrent->supplementary_page_table, &p->elem);
-    free (prev_p);
-    supplementary_lock_release(tcurrent);
-    return true;;
-  }
-  else
-  {
-    free(p);
-    supplementary_lock_release(tcurrent);
-    return false;
+    // swap을 오가면 자기만의 frame을 갖게 된다.
+    p->cow = false;
   }
+  supplementary_lock_release(tcurrent);
+  return p != NULL;
+}
+
+/* Prints supplementary page table statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Page: %lld lookups, %lld swap state updates, "
+          "%lld allocations in page faults\n",
+          page_lookup_cnt, page_update_cnt, page_alloc_cnt);
 }
 
 void remove_page (struct hash_elem* target_elem, void *aux UNUSED)
@@ -96,4 +127,170 @@ set_new_dirty_page (void* new_esp, struct thread* t)
     pagedir_set_stack (t->pagedir, pg_round_down (t->user_esp), true);
   }
 }
+
+/* T의 page cache frame mapping을 모두 해제한다.
+ * pagedir_destroy()가 공유 frame을 free하지 않도록
+ * 그 전에 불려야 한다. fork 후 공유하는 frame은
+ * frame_table_delete()가 이미 해제했다. */
+void
+page_unmap_shared (struct thread* t)
+{
+  struct hash_iterator i;
+
+  if (t->pagedir == NULL || hash_empty (&t->supplementary_page_table))
+    return;
+  supplementary_lock_acquire (t);
+  hash_first (&i, &t->supplementary_page_table);
+  while (hash_next (&i))
+  {
+    struct page* p = hash_entry (hash_cur (&i), struct page, elem);
+    void* upage = (void *) p->load_vaddr;
+    if (p->shared)
+      pcache_unmap (t->pagedir, upage);
+  }
+  supplementary_lock_release (t);
+}
+
+/* CHILD의 mmap_list에서 UPAGE를 포함하는 mapping의 file을 찾는다. */
+static struct file*
+mmap_file (struct thread* child, void* upage)
+{
+  struct list_elem* e;
+  for (e = list_begin (&child->mmap_list); e != list_end (&child->mmap_list);
+       e = list_next (e))
+  {
+    struct mmap_elem* mi = list_entry (e, struct mmap_elem, elem);
+    if (mi->start_vaddr <= (uint32_t) upage
+        && (uint32_t) upage < mi->start_vaddr + mi->read_bytes)
+      return mi->f;
+  }
+  return NULL;
+}
+
+/* PARENT의 mmap page 중 메모리에서 고쳐진 것을 파일에 쓴다.
+ * CHILD는 mmap page를 파일에서 읽으므로 page_fork()가 먼저
+ * 부른다. frame이 evict되지 않도록 swap_lock 아래에서는
+ * bounce page로 복사만 하고, 파일에는 lock 없이 쓴다.
+ * bounce page를 얻지 못하면 false를 돌려준다. */
+static bool
+page_fork_write_back (struct thread* parent, struct thread* child)
+{
+  struct list_elem* e;
+  uint8_t* bounce = palloc_get_page (0);
+  if (bounce == NULL)
+    return false;
+
+  for (e = list_begin (&child->mmap_list); e != list_end (&child->mmap_list);
+       e = list_next (e))
+  {
+    struct mmap_elem* mc = list_entry (e, struct mmap_elem, elem);
+    uint32_t ofs;
+    for (ofs = 0; ofs < mc->read_bytes; ofs += PGSIZE)
+    {
+      void* upage = (void *) (mc->start_vaddr + ofs);
+      size_t bytes = mc->read_bytes - ofs < PGSIZE
+                     ? mc->read_bytes - ofs : PGSIZE;
+      bool dirty = false;
+      void* kpage;
+
+      swap_lock_acquire ();
+      kpage = pagedir_get_page (parent->pagedir, upage);
+      if (kpage != NULL && pagedir_is_dirty (parent->pagedir, upage))
+      {
+        pagedir_set_dirty (parent->pagedir, upage, false);
+        memcpy (bounce, kpage, bytes);
+        dirty = true;
+      }
+      swap_lock_release ();
+      if (dirty)
+        file_write_at (mc->f, bounce, bytes, ofs);
+    }
+  }
+  palloc_free_page (bounce);
+  return true;
+}
+
+/* fork()된 CHILD의 supplementary page table과 page directory를
+ * PARENT의 것으로 채운다. 메모리에 있는 private page는 복사하지
+ * 않고 두 프로세스가 읽기 전용으로 함께 map하며(copy-on-write),
+ * 먼저 쓰는 쪽이 page_fault에서 자기 복사본을 만든다.
+ * swap된 page는 slot을 복사하고, 아직 로드되지 않은 page와
+ * page cache page, mmap page는 CHILD가 다시 fault해서 가져온다.
+ * CHILD의 exec_file, mmap_list, user_esp가 먼저 준비되어 있어야
+ * 한다. 실패하면 false를 돌려주고, 그때까지 만든 것은
+ * CHILD가 exit할 때 정리된다. */
+bool
+page_fork (struct thread* parent, struct thread* child)
+{
+  struct hash_iterator i;
+  bool success = true;
+
+  if (!page_fork_write_back (parent, child))
+    return false;
+
+  // 복사하는 동안 PARENT의 frame이 evict되지 않게 한다.
+  swap_lock_acquire ();
+  supplementary_lock_acquire (parent);
+  hash_first (&i, &parent->supplementary_page_table);
+  while (success && hash_next (&i))
+  {
+    struct page* p = hash_entry (hash_cur (&i), struct page, elem);
+    void* upage = (void *) p->load_vaddr;
+    void* kpage = pagedir_get_page (parent->pagedir, upage);
+    struct page* c = malloc (sizeof (struct page));
+    if (c == NULL)
+    {
+      success = false;
+      break;
+    }
+    *c = *p;
+
+    if (p->mmaped)
+      // 고쳐진 내용은 page_fork_write_back()이 이미 파일에 썼다.
+      c->f = mmap_file (child, upage);
+    else
+    {
+      if (p->f != NULL)
+        c->f = child->exec_file;
+      if (p->swap_outed)
+      {
+        c->swap_index = swap_slot_copy (p->swap_index);
+        success = c->swap_index != BITMAP_ERROR;
+      }
+      else if (kpage != NULL && !p->shared)
+      {
+        struct frame_elem* fr_elem = frame_elem_alloc ();
+        if (fr_elem == NULL
+            || !pagedir_set_page (child->pagedir, upage, kpage, false))
+        {
+          frame_elem_free (fr_elem);
+          success = false;
+        }
+        else
+        {
+          pagedir_set_writable (parent->pagedir, upage, false);
+          p->cow = c->cow = true;
+          fr_elem->pd = child->pagedir;
+          fr_elem->vaddr = upage;
+          fr_elem->pd_thread = child;
+          frame_table_push_back (fr_elem);
+        }
+      }
+    }
+
+    if (success)
+    {
+      supplementary_lock_acquire (child);
+      hash_insert (&child->supplementary_page_table, &c->elem);
+      supplementary_lock_release (child);
+    }
+    else
+      free (c);
+  }
+  supplementary_lock_release (parent);
+  swap_lock_release ();
+
+  pagedir_set_stack (child->pagedir, pg_round_down (child->user_esp), true);
+  return success;
+}
 #endif
@@ -20,6 +20,8 @@ struct page
   bool writable;
   bool swap_outed;  /* if true, find this from swap disk */
   bool mmaped;
+  bool shared;      /* if true, frame belongs to the page cache */
+  bool cow;         /* if true, frame may be shared with a forked process */
   uint32_t swap_index;
 };
 
@@ -29,6 +31,10 @@ struct page * page_lookup (const void *address, struct thread* tcurrent);
 bool page_swap_out_index (const void *address, struct thread* tcurrent, bool new_swap_outed, uint32_t new_index);
 void remove_page (struct hash_elem* target_elem, void *aux UNUSED);
 void set_new_dirty_page (void* new_esp, struct thread* t);
+void *page_fault_malloc (size_t size);
+void page_print_stats (void);
+void page_unmap_shared (struct thread* t);
+bool page_fork (struct thread* parent, struct thread* child);
 
 #endif
 #endif
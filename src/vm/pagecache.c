@@ -0,0 +1,483 @@
+#include "vm/pagecache.h"
+#ifdef PRJ3
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Page cache.  A file page that user processes map read-only
+   (the text and read-only data of executables) is read into one
+   frame, and every address space that maps it shares that frame
+   instead of reading its own copy.  The frames also serve
+   inode_read_at(), so a read of a page that is mapped somewhere
+   costs a memcpy and no trip through the buffer cache.
+
+   Pages are named by the sector of the file's inode and their
+   page-aligned offset, so they outlive the struct inode and a
+   program run again finds its text still cached.  A page nobody
+   maps stays cached until pcache_reclaim() hands its frame back
+   under memory pressure, or until the file is removed.
+
+   Each page keeps the list of its mappings, which is its
+   reference count, so that evicting it can unmap it from every
+   address space that shares it at once. */
+struct pcache_page
+{
+  struct hash_elem key_elem;    /* Element in pcache_pages. */
+  struct hash_elem frame_elem;  /* Element in pcache_frames. */
+  struct list_elem lru_elem;    /* Element in pcache_lru. */
+  disk_sector_t inumber;        /* File's inode sector. */
+  off_t ofs;                    /* Page-aligned file offset. */
+  size_t read_bytes;            /* File bytes in the page; rest zero. */
+  void *kpage;                  /* Frame holding the page. */
+  struct list mappings;         /* List of struct pcache_mapping. */
+  bool orphan;                  /* File removed; free at last unmap. */
+};
+
+/* A page table entry that maps a cached page. */
+struct pcache_mapping
+{
+  struct list_elem elem;        /* Element in pcache_page's mappings. */
+  uint32_t *pd;                 /* Page directory. */
+  void *upage;                  /* User virtual address. */
+};
+
+static struct hash pcache_pages;        /* By (inumber, ofs). */
+static struct hash pcache_frames;       /* By kpage. */
+static struct list pcache_lru;          /* Least recently used first. */
+static struct lock pcache_lock;
+
+/* Bumped by every write that goes through the page cache, so a
+   page read in without the lock can tell it may be stale. */
+static unsigned pcache_gen;
+
+static hash_hash_func key_hash, frame_hash;
+static hash_less_func key_less, frame_less;
+static struct pcache_page *lookup (disk_sector_t, off_t);
+static struct pcache_page *lookup_frame (void *);
+static bool add_mapping (struct pcache_page *, struct thread *, void *);
+static void release (struct pcache_page *);
+
+void
+pcache_init (void)
+{
+  hash_init (&pcache_pages, key_hash, key_less, NULL);
+  hash_init (&pcache_frames, frame_hash, frame_less, NULL);
+  list_init (&pcache_lru);
+  lock_init (&pcache_lock);
+}
+
+/* Maps the page at OFS in INODE, whose first READ_BYTES bytes
+   come from the file, read-only at UPAGE in T's address space.
+   KPAGE is a zeroed frame the caller allocated for it.  If the
+   page is already cached, KPAGE is freed and the cached frame is
+   used; otherwise KPAGE is filled and cached.
+
+   If *SHARED is set on return, the frame belongs to the page
+   cache and has already been mapped and entered into the frame
+   table.  Otherwise another mapping of the page disagrees on
+   READ_BYTES or a write raced with the read, and the returned
+   frame holds a private copy that the caller maps as usual.
+   Returns NULL, with KPAGE freed, if the file cannot be read or
+   the page cannot be mapped. */
+void *
+pcache_map (struct inode *inode, off_t ofs, size_t read_bytes, void *kpage,
+            struct thread *t, void *upage, bool *shared)
+{
+  disk_sector_t inumber = inode_get_inumber (inode);
+  struct pcache_page *p;
+  unsigned gen;
+
+  ASSERT (pg_ofs (kpage) == 0 && ofs % PGSIZE == 0);
+  ASSERT (read_bytes <= PGSIZE);
+
+  *shared = false;
+  lock_acquire (&pcache_lock);
+  p = lookup (inumber, ofs);
+  if (p != NULL)
+  {
+    if (p->read_bytes == read_bytes)
+    {
+      bool success = add_mapping (p, t, upage);
+      if (success)
+      {
+        list_remove (&p->lru_elem);
+        list_push_back (&pcache_lru, &p->lru_elem);
+      }
+      lock_release (&pcache_lock);
+      palloc_free_page (kpage);
+      *shared = success;
+      return success ? p->kpage : NULL;
+    }
+    /* Another mapping disagrees on the page's extent, so this
+       one gets a private copy.  Take it from the cached page if
+       that holds enough of the file. */
+    if (read_bytes <= p->read_bytes)
+    {
+      memcpy (kpage, p->kpage, read_bytes);
+      lock_release (&pcache_lock);
+      return kpage;
+    }
+  }
+  gen = pcache_gen;
+  lock_release (&pcache_lock);
+
+  /* inode_read_at() looks in the page cache itself, so the lock
+     must not be held across it. */
+  if (inode_read_at (inode, kpage, read_bytes, ofs) != (off_t) read_bytes)
+  {
+    palloc_free_page (kpage);
+    return NULL;
+  }
+  if (p != NULL)
+    return kpage;
+
+  p = page_fault_malloc (sizeof *p);
+  if (p == NULL)
+    return kpage;
+  p->inumber = inumber;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->kpage = kpage;
+  list_init (&p->mappings);
+  p->orphan = false;
+
+  lock_acquire (&pcache_lock);
+  if (gen != pcache_gen || lookup (inumber, ofs) != NULL)
+  {
+    /* A write may have missed KPAGE, or another process cached
+       the page first.  Either way keep KPAGE private. */
+    lock_release (&pcache_lock);
+    free (p);
+    return kpage;
+  }
+  if (!add_mapping (p, t, upage))
+  {
+    lock_release (&pcache_lock);
+    free (p);
+    palloc_free_page (kpage);
+    return NULL;
+  }
+  hash_insert (&pcache_pages, &p->key_elem);
+  hash_insert (&pcache_frames, &p->frame_elem);
+  list_push_back (&pcache_lru, &p->lru_elem);
+  lock_release (&pcache_lock);
+  *shared = true;
+  return kpage;
+}
+
+/* Unmaps the cached page mapped at UPAGE in PD, if any, which
+   must be a mapping made by pcache_map().  The page stays
+   cached. */
+void
+pcache_unmap (uint32_t *pd, void *upage)
+{
+  struct pcache_page *p;
+  struct list_elem *e;
+
+  lock_acquire (&pcache_lock);
+  p = lookup_frame (pagedir_get_page (pd, upage));
+  if (p != NULL)
+    for (e = list_begin (&p->mappings); e != list_end (&p->mappings);
+         e = list_next (e))
+    {
+      struct pcache_mapping *m = list_entry (e, struct pcache_mapping, elem);
+      if (m->pd == pd && m->upage == upage)
+      {
+        list_remove (e);
+        frame_elem_remove (upage, pd);
+        pagedir_clear_page (pd, upage);
+        free (m);
+        break;
+      }
+    }
+  if (p != NULL && list_empty (&p->mappings) && p->orphan)
+  {
+    hash_delete (&pcache_frames, &p->frame_elem);
+    list_remove (&p->lru_elem);
+    release (p);
+  }
+  lock_release (&pcache_lock);
+}
+
+/* Evicts the cached page mapped at UPAGE in PD: unmaps it from
+   every address space that shares it, drops their frame table
+   entries and frees its frame.  The processes fault it back in
+   from the file.  Does nothing if nothing is mapped there. */
+void
+pcache_evict (uint32_t *pd, void *upage)
+{
+  struct pcache_page *p;
+
+  lock_acquire (&pcache_lock);
+  p = lookup_frame (pagedir_get_page (pd, upage));
+  if (p != NULL)
+  {
+    while (!list_empty (&p->mappings))
+    {
+      struct pcache_mapping *m = list_entry (list_pop_front (&p->mappings),
+                                             struct pcache_mapping, elem);
+      frame_elem_remove (m->upage, m->pd);
+      pagedir_clear_page (m->pd, m->upage);
+      free (m);
+    }
+    if (!p->orphan)
+      hash_delete (&pcache_pages, &p->key_elem);
+    hash_delete (&pcache_frames, &p->frame_elem);
+    list_remove (&p->lru_elem);
+    release (p);
+  }
+  lock_release (&pcache_lock);
+}
+
+/* Frees the frame of the least recently used page that nobody
+   maps.  Returns false if there is no such page. */
+bool
+pcache_reclaim (void)
+{
+  struct list_elem *e;
+
+  lock_acquire (&pcache_lock);
+  for (e = list_begin (&pcache_lru); e != list_end (&pcache_lru);
+       e = list_next (e))
+  {
+    struct pcache_page *p = list_entry (e, struct pcache_page, lru_elem);
+    if (list_empty (&p->mappings))
+    {
+      list_remove (e);
+      hash_delete (&pcache_pages, &p->key_elem);
+      hash_delete (&pcache_frames, &p->frame_elem);
+      release (p);
+      lock_release (&pcache_lock);
+      return true;
+    }
+  }
+  lock_release (&pcache_lock);
+  return false;
+}
+
+/* Copies SIZE bytes at OFFSET in the file whose inode is at
+   INUMBER into BUFFER, if a single cached page holds all of
+   them.  Returns true if it did.  BUFFER must be in kernel
+   memory: a fault on a user buffer could need pcache_lock,
+   which is held during the copy.  inode_read_at() bounces user
+   buffers through a kernel page for this reason. */
+bool
+pcache_read (disk_sector_t inumber, void *buffer, off_t size, off_t offset)
+{
+  off_t page_ofs = offset - offset % PGSIZE;
+  struct pcache_page *p;
+  bool hit = false;
+
+  ASSERT (!is_user_vaddr (buffer));
+  if (hash_empty (&pcache_pages) || offset % PGSIZE + size > PGSIZE)
+    return false;
+  lock_acquire (&pcache_lock);
+  p = lookup (inumber, page_ofs);
+  if (p != NULL && (size_t) (offset % PGSIZE + size) <= p->read_bytes)
+  {
+    memcpy (buffer, (uint8_t *) p->kpage + offset % PGSIZE, size);
+    hit = true;
+  }
+  lock_release (&pcache_lock);
+  return hit;
+}
+
+/* Copies SIZE bytes written to OFFSET in the file whose inode is
+   at INUMBER from BUFFER into whichever cached pages hold them,
+   so that mappings and later reads see the write.  BUFFER must
+   be in kernel memory, as for pcache_read(). */
+void
+pcache_write (disk_sector_t inumber, const void *buffer_, off_t size,
+              off_t offset)
+{
+  const uint8_t *buffer = buffer_;
+  off_t page_ofs;
+
+  ASSERT (!is_user_vaddr (buffer));
+  if (size <= 0)
+    return;
+  lock_acquire (&pcache_lock);
+  pcache_gen++;
+  if (!hash_empty (&pcache_pages))
+    for (page_ofs = offset - offset % PGSIZE; page_ofs < offset + size;
+         page_ofs += PGSIZE)
+    {
+      struct pcache_page *p = lookup (inumber, page_ofs);
+      off_t start, end;
+
+      if (p == NULL)
+        continue;
+      start = offset > page_ofs ? offset : page_ofs;
+      end = offset + size < page_ofs + (off_t) p->read_bytes
+            ? offset + size : page_ofs + (off_t) p->read_bytes;
+      if (start < end)
+        memcpy ((uint8_t *) p->kpage + (start - page_ofs),
+                buffer + (start - offset), end - start);
+    }
+  lock_release (&pcache_lock);
+}
+
+/* Returns true if any page of the file whose inode is at INUMBER
+   is cached. */
+bool
+pcache_cached (disk_sector_t inumber)
+{
+  struct list_elem *e;
+  bool cached = false;
+
+  if (hash_empty (&pcache_pages))
+    return false;
+  lock_acquire (&pcache_lock);
+  for (e = list_begin (&pcache_lru); e != list_end (&pcache_lru);
+       e = list_next (e))
+    if (list_entry (e, struct pcache_page, lru_elem)->inumber == inumber)
+    {
+      cached = true;
+      break;
+    }
+  lock_release (&pcache_lock);
+  return cached;
+}
+
+/* Forgets the pages of the file whose inode is at INUMBER, which
+   is being removed, so that a file reusing the sector does not
+   find them.  Pages still mapped are freed at their last unmap. */
+void
+pcache_drop (disk_sector_t inumber)
+{
+  struct list_elem *e;
+
+  if (hash_empty (&pcache_pages))
+    return;
+  lock_acquire (&pcache_lock);
+  for (e = list_begin (&pcache_lru); e != list_end (&pcache_lru);)
+  {
+    struct pcache_page *p = list_entry (e, struct pcache_page, lru_elem);
+    if (p->inumber != inumber || p->orphan)
+    {
+      e = list_next (e);
+      continue;
+    }
+    hash_delete (&pcache_pages, &p->key_elem);
+    if (!list_empty (&p->mappings))
+    {
+      p->orphan = true;
+      e = list_next (e);
+      continue;
+    }
+    e = list_remove (e);
+    hash_delete (&pcache_frames, &p->frame_elem);
+    release (p);
+  }
+  lock_release (&pcache_lock);
+}
+
+/* Returns the cached page at OFS in the file whose inode is at
+   INUMBER, or NULL.  The caller must hold pcache_lock. */
+static struct pcache_page *
+lookup (disk_sector_t inumber, off_t ofs)
+{
+  struct pcache_page key;
+  struct hash_elem *e;
+
+  key.inumber = inumber;
+  key.ofs = ofs;
+  e = hash_find (&pcache_pages, &key.key_elem);
+  return e != NULL ? hash_entry (e, struct pcache_page, key_elem) : NULL;
+}
+
+/* Returns the cached page held in frame KPAGE, or NULL.  The
+   caller must hold pcache_lock. */
+static struct pcache_page *
+lookup_frame (void *kpage)
+{
+  struct pcache_page key;
+  struct hash_elem *e;
+
+  if (kpage == NULL)
+    return NULL;
+  key.kpage = kpage;
+  e = hash_find (&pcache_frames, &key.frame_elem);
+  return e != NULL ? hash_entry (e, struct pcache_page, frame_elem) : NULL;
+}
+
+/* Maps P read-only at UPAGE in T's address space and enters the
+   mapping into the frame table.  The caller must hold
+   pcache_lock, so that pcache_evict() cannot run in between.
+   Returns false if out of memory. */
+static bool
+add_mapping (struct pcache_page *p, struct thread *t, void *upage)
+{
+  struct pcache_mapping *m = page_fault_malloc (sizeof *m);
+  struct frame_elem *fr_elem = frame_elem_alloc ();
+
+  if (m == NULL || fr_elem == NULL
+      || !pagedir_set_page (t->pagedir, upage, p->kpage, false))
+  {
+    free (m);
+    frame_elem_free (fr_elem);
+    return false;
+  }
+  m->pd = t->pagedir;
+  m->upage = upage;
+  list_push_back (&p->mappings, &m->elem);
+
+  fr_elem->pd = t->pagedir;
+  fr_elem->vaddr = upage;
+  fr_elem->pd_thread = t;
+  frame_table_push_back (fr_elem);
+  return true;
+}
+
+/* Frees P and its frame.  P must be in no table any more. */
+static void
+release (struct pcache_page *p)
+{
+  palloc_free_page (p->kpage);
+  free (p);
+}
+
+static unsigned
+key_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct pcache_page *p = hash_entry (e, struct pcache_page, key_elem);
+  return hash_int (p->inumber) ^ hash_int (p->ofs);
+}
+
+static bool
+key_less (const struct hash_elem *a_, const struct hash_elem *b_,
+          void *aux UNUSED)
+{
+  const struct pcache_page *a = hash_entry (a_, struct pcache_page, key_elem);
+  const struct pcache_page *b = hash_entry (b_, struct pcache_page, key_elem);
+  return a->inumber != b->inumber ? a->inumber < b->inumber : a->ofs < b->ofs;
+}
+
+static unsigned
+frame_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct pcache_page *p = hash_entry (e, struct pcache_page,
+                                            frame_elem);
+  return hash_bytes (&p->kpage, sizeof p->kpage);
+}
+
+static bool
+frame_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct pcache_page *a = hash_entry (a_, struct pcache_page,
+                                            frame_elem);
+  const struct pcache_page *b = hash_entry (b_, struct pcache_page,
+                                            frame_elem);
+  return a->kpage < b->kpage;
+}
+#endif
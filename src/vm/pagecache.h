@@ -0,0 +1,28 @@
+#ifndef __VM_PAGECACHE_H
+#define __VM_PAGECACHE_H
+#ifdef PRJ3
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/disk.h"
+#include "filesys/off_t.h"
+
+struct inode;
+struct thread;
+
+void pcache_init (void);
+void *pcache_map (struct inode *inode, off_t ofs, size_t read_bytes,
+                  void *kpage, struct thread *t, void *upage, bool *shared);
+void pcache_unmap (uint32_t *pd, void *upage);
+void pcache_evict (uint32_t *pd, void *upage);
+bool pcache_reclaim (void);
+
+bool pcache_read (disk_sector_t inumber, void *buffer, off_t size,
+                  off_t offset);
+void pcache_write (disk_sector_t inumber, const void *buffer, off_t size,
+                   off_t offset);
+bool pcache_cached (disk_sector_t inumber);
+void pcache_drop (disk_sector_t inumber);
+
+#endif
+#endif
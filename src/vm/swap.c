@@ -1,12 +1,40 @@
 #include "vm/swap.h"
 #ifdef PRJ3
+#include <hash.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
 
+/* Frame table. user pool의 frame 번호로 바로 찾는 배열이고,
+ * frame마다 그 frame을 map한 (thread, upage)의 reverse map을
+ * 갖는다. 공유되지 않는 frame은 mapping이 하나뿐이고, fork 후
+ * copy-on-write로 함께 map한 frame은 reverse map의 길이가 곧
+ * 공유하는 프로세스 수이다. */
+struct frame
+{
+  struct list maps;     /* struct frame_elem의 list. */
+};
 
-static struct list frame_table;
+static struct frame* frame_table;
+static size_t frame_cnt;
+static size_t clock_hand;       /* 다음에 볼 frame 번호. */
 static struct bitmap* swap_table;
 static struct lock frame_lock;
 static struct lock swap_lock;
 
+/* 쓰지 않는 frame_elem. page fault마다 malloc하지 않도록 frame마다
+ * 하나씩 미리 만들어 두고, 공유 mapping 때문에 모자라면 그때
+ * 더 만든다. 만든 것은 free하지 않고 여기로 돌려준다. */
+static struct list free_elems;
+static struct lock free_elems_lock;
+
+static struct frame* frame_of (void* kpage);
+static struct frame_elem* frame_map_find (uint32_t* pd, void* upage);
+static bool frame_referenced (struct frame* fr);
+
 void swap_table_bitmap_init (void)
 {
   struct disk* d = disk_get(1,1);
@@ -33,104 +61,260 @@ swap_table_scan_and_flip (void)
   return ans;
 }
 
+/* swap_table_scan_and_flip()으로 잡은 slot을 쓰지 않고 돌려준다.
+ * swap_lock을 잡은 채로 불려야 한다. */
+void
+swap_table_unflip (size_t idx)
+{
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+  if (idx != BITMAP_ERROR)
+    bitmap_set (swap_table, idx, false);
+}
+
+/* swap slot IDX를 새 slot에 복사하고 그 index를 돌려준다.
+ * slot이 없으면 BITMAP_ERROR. swap_lock을 잡은 채로 불려야 한다. */
+size_t
+swap_slot_copy (size_t idx)
+{
+  struct disk* d = disk_get(1,1);
+  uint8_t* buffer;
+  size_t copy;
+  disk_sector_t i;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+  buffer = malloc (DISK_SECTOR_SIZE);
+  if (buffer == NULL)
+    return BITMAP_ERROR;
+  copy = bitmap_scan_and_flip (swap_table, 0, 1, false);
+  if (copy != BITMAP_ERROR)
+    for (i = 0; i < 8; i++)
+    {
+      disk_read (d, idx*8 + i, buffer);
+      disk_write (d, copy*8 + i, buffer);
+    }
+  free (buffer);
+  return copy;
+}
+
 void
 frame_table_init (void)
 {
+  struct frame_elem* elems;
+  size_t i;
+  frame_cnt = palloc_user_page_cnt ();
+  frame_table = malloc (frame_cnt * sizeof *frame_table);
+  elems = malloc (frame_cnt * sizeof *elems);
+  ASSERT (frame_table != NULL && elems != NULL);
+  list_init (&free_elems);
+  for (i = 0; i < frame_cnt; i++)
+  {
+    list_init (&frame_table[i].maps);
+    list_push_back (&free_elems, &elems[i].elem);
+  }
+  clock_hand = 0;
   lock_init (&frame_lock);
-  list_init (&frame_table);
+  lock_init (&free_elems_lock);
+}
+
+/* 새 frame_elem을 돌려준다. 미리 만든 것이 모두 쓰이고 있을
+ * 때만 malloc하고, 그것도 실패하면 NULL. */
+struct frame_elem*
+frame_elem_alloc (void)
+{
+  struct frame_elem* e = NULL;
+  lock_acquire (&free_elems_lock);
+  if (!list_empty (&free_elems))
+    e = list_entry (list_pop_front (&free_elems), struct frame_elem, elem);
+  lock_release (&free_elems_lock);
+  return e != NULL ? e : page_fault_malloc (sizeof *e);
 }
 
+/* frame_elem_alloc()으로 얻은 E를 돌려준다. E는 null pointer일
+ * 수 있다. */
+void
+frame_elem_free (struct frame_elem* e)
+{
+  if (e == NULL)
+    return;
+  lock_acquire (&free_elems_lock);
+  list_push_back (&free_elems, &e->elem);
+  lock_release (&free_elems_lock);
+}
+
+/* E->pd에서 E->vaddr에 map된 frame의 reverse map에 E를 넣는다.
+ * page를 map한 뒤에 불려야 한다. */
 void
 frame_table_push_back (struct frame_elem* e)
 {
+  void* kpage = pagedir_get_page (e->pd, e->vaddr);
+  ASSERT (kpage != NULL);
   lock_acquire (&frame_lock);
-  list_push_back (&frame_table, e);
+  list_push_back (&frame_of (kpage)->maps, &e->elem);
   lock_release (&frame_lock);
 }
 
+/* clock hand를 돌리면서 최근에 접근되지 않았고 stack page도
+ * 아닌 frame을 찾아, 그 mapping 하나를 reverse map에서 빼서
+ * 돌려준다. 다른 mapping이 남아 있어 frame을 free하면 안 되면
+ * *SHARED를 true로 한다. 지나가는 frame의 accessed bit는 지운다.
+ * 두 바퀴를 돌아도 없으면(모두 stack page) NULL. */
 struct frame_elem*
-frame_table_find_victim (void)
+frame_table_find_victim (bool* shared)
 {
-  lock_acquire (&frame_lock);
-  struct frame_elem* totest;
-  struct list_elem* elem_pointer;
-  size_t next_size, prev_size = frame_table_size();
-  if (list_empty (&frame_table))
-  {
-    lock_release (&frame_lock);
-    return NULL;
-  }
+  struct frame_elem* victim = NULL;
+  size_t scanned;
 
-  elem_pointer = list_pop_front(&frame_table);
-  totest = list_entry (elem_pointer, struct frame_elem, elem);
-  while(pagedir_is_accessed (totest->pd, totest->vaddr) ||
-      pagedir_is_stack (totest->pd, totest->vaddr))
+  lock_acquire (&frame_lock);
+  for (scanned = 0; scanned < 2 * frame_cnt; scanned++)
   {
-    pagedir_set_accessed (totest->pd, totest->vaddr, false);
-    list_push_back (&frame_table, elem_pointer);
-    elem_pointer = list_pop_front (&frame_table);
-    totest = list_entry (elem_pointer, struct frame_elem, elem);
-    //printf("totest : %p, totest->pd : %p, totest->vaddr : %p...\n",\
-        totest, totest->pd, totest->vaddr);
+    struct frame* fr = &frame_table[clock_hand];
+    clock_hand = (clock_hand + 1) % frame_cnt;
+    if (list_empty (&fr->maps) || frame_referenced (fr))
+      continue;
+    victim = list_entry (list_pop_front (&fr->maps), struct frame_elem, elem);
+    *shared = !list_empty (&fr->maps);
+    ASSERT (is_user_vaddr (victim->vaddr));
+    ASSERT (victim->pd_thread != NULL);
+    break;
   }
-  next_size = frame_table_size();
-  ASSERT (is_kernel_vaddr(totest));
-  ASSERT (is_user_vaddr(totest->vaddr));
-  ASSERT (next_size == prev_size - 1);
-  ASSERT (totest->pd_thread != NULL);
-
   lock_release (&frame_lock);
-  return totest;
+  return victim;
 }
 
+/* T가 map하고 있는 frame의 reverse map에서 T의 mapping을 모두
+ * 뺀다. frame 전체가 아니라 T의 supplementary page table만 돈다.
+ * fork한 다른 프로세스가 아직 map하고 있는 copy-on-write frame은
+ * pagedir_destroy()가 free하지 않도록 T에서 unmap한다. */
 void
-frame_table_delete (uint32_t pd)
+frame_table_delete (struct thread* t)
 {
-  struct frame_elem* i;
+  struct hash_iterator i;
+
+  if (t->pagedir == NULL || hash_empty (&t->supplementary_page_table))
+    return;
+  supplementary_lock_acquire (t);
   lock_acquire (&frame_lock);
-  struct list_elem* elem_pointer = list_begin(&frame_table);
-  while (elem_pointer != list_end(&frame_table))
+  hash_first (&i, &t->supplementary_page_table);
+  while (hash_next (&i))
   {
-    i = list_entry(elem_pointer , struct frame_elem, elem);
-    if (i->pd == pd)
+    struct page* p = hash_entry (hash_cur (&i), struct page, elem);
+    void* upage = (void *) p->load_vaddr;
+    struct frame_elem* e = frame_map_find (t->pagedir, upage);
+    if (e != NULL)
     {
-      elem_pointer = list_remove (elem_pointer);
-      free (i);
+      struct frame* fr = frame_of (pagedir_get_page (t->pagedir, upage));
+      list_remove (&e->elem);
+      frame_elem_free (e);
+      if (p->cow && !list_empty (&fr->maps))
+        pagedir_clear_page (t->pagedir, upage);
     }
-    else
-      elem_pointer = list_next(elem_pointer);
   }
   lock_release (&frame_lock);
+  supplementary_lock_release (t);
 }
 
+/* TARGET_PD에서 TARGET_ADDR의 mapping을 reverse map에서 빼고
+ * frame을 free한 뒤 unmap한다. */
 void
 frame_elem_delete (void* target_addr, uint32_t* target_pd)
 {
-  struct frame_elem* i;
+  struct frame_elem* e;
   lock_acquire (&frame_lock);
-  struct list_elem* elem_pointer = list_begin(&frame_table);
-  while (elem_pointer != list_end(&frame_table))
+  e = frame_map_find (target_pd, target_addr);
+  if (e != NULL)
   {
-    i = list_entry(elem_pointer , struct frame_elem, elem);
-    if (i->vaddr == target_addr && i->pd == target_pd)
-    {
-      elem_pointer = list_remove (elem_pointer);
-      palloc_free_page(pagedir_get_page (i->pd, i->vaddr));
-      pagedir_clear_page(i->pd, i->vaddr);
-      free (i);
-    }
-    else
-      elem_pointer = list_next(elem_pointer);
+    list_remove (&e->elem);
+    palloc_free_page (pagedir_get_page (target_pd, target_addr));
+    pagedir_clear_page (target_pd, target_addr);
+    frame_elem_free (e);
   }
   lock_release (&frame_lock);
 }
 
-size_t
-frame_table_size (void)
+/* frame_elem_delete()와 같지만 frame은 free하지 않고 unmap도
+ * 하지 않는다. unmap하기 전에 불려야 한다. 그 frame을 아직
+ * 다른 곳에서 map하고 있으면 true를 돌려준다. */
+bool
+frame_elem_remove (void* target_addr, uint32_t* target_pd)
+{
+  struct frame_elem* e;
+  bool shared = false;
+  lock_acquire (&frame_lock);
+  e = frame_map_find (target_pd, target_addr);
+  if (e != NULL)
+  {
+    struct frame* fr = frame_of (pagedir_get_page (target_pd, target_addr));
+    list_remove (&e->elem);
+    frame_elem_free (e);
+    shared = !list_empty (&fr->maps);
+  }
+  lock_release (&frame_lock);
+  return shared;
+}
+
+/* KPAGE를 둘 이상의 곳에서 map하고 있으면 true. */
+bool
+frame_is_shared (void* kpage)
+{
+  struct frame* fr;
+  bool shared;
+  lock_acquire (&frame_lock);
+  fr = frame_of (kpage);
+  shared = list_size (&fr->maps) > 1;
+  lock_release (&frame_lock);
+  return shared;
+}
+
+/* KPAGE의 frame table entry. */
+static struct frame*
+frame_of (void* kpage)
+{
+  return &frame_table[palloc_user_page_no (kpage)];
+}
+
+/* PD에서 UPAGE를 map하고 있는 frame의 reverse map에서 그 mapping을
+ * 찾는다. frame_lock을 잡은 채로 불려야 한다. */
+static struct frame_elem*
+frame_map_find (uint32_t* pd, void* upage)
 {
-  return list_size (&frame_table);
+  void* kpage = pagedir_get_page (pd, upage);
+  struct list_elem* e;
+  struct frame* fr;
+
+  if (kpage == NULL)
+    return NULL;
+  fr = frame_of (kpage);
+  for (e = list_begin (&fr->maps); e != list_end (&fr->maps); e = list_next (e))
+  {
+    struct frame_elem* fe = list_entry (e, struct frame_elem, elem);
+    if (fe->pd == pd && fe->vaddr == upage)
+      return fe;
+  }
+  return NULL;
 }
 
+/* FR을 map한 곳 중 하나라도 최근에 접근했거나 stack page이면
+ * true. 접근한 mapping의 accessed bit는 지워서 다음 바퀴에는
+ * victim이 될 수 있게 한다. frame_lock을 잡은 채로 불려야 한다. */
+static bool
+frame_referenced (struct frame* fr)
+{
+  struct list_elem* e;
+  bool referenced = false;
+
+  for (e = list_begin (&fr->maps); e != list_end (&fr->maps); e = list_next (e))
+  {
+    struct frame_elem* fe = list_entry (e, struct frame_elem, elem);
+    if (pagedir_is_stack (fe->pd, fe->vaddr))
+      referenced = true;
+    else if (pagedir_is_accessed (fe->pd, fe->vaddr))
+    {
+      pagedir_set_accessed (fe->pd, fe->vaddr, false);
+      referenced = true;
+    }
+  }
+  return referenced;
+}
 
 void 
 swap_lock_acquire (void)
@@ -7,9 +7,10 @@
 #include "threads/pte.h"
 #include "threads/synch.h"
 
+/* reverse map entry: PD_THREAD의 PD에서 VADDR에 map된 frame. */
 struct frame_elem
 {
-  struct list_elem elem;
+  struct list_elem elem;        /* struct frame의 maps에 들어간다. */
   struct thread* pd_thread;
   uint32_t *pd;
   void* vaddr; /* corresponding page pointer */
@@ -18,13 +19,18 @@ struct frame_elem
 void swap_table_bitmap_init (void);
 void swap_table_bitmap_set (size_t idx, bool toset);
 size_t swap_table_scan_and_flip (void);
+void swap_table_unflip (size_t idx);
+size_t swap_slot_copy (size_t idx);
 
 void frame_table_init (void);
+struct frame_elem* frame_elem_alloc (void);
+void frame_elem_free (struct frame_elem* e);
 void frame_table_push_back (struct frame_elem* e);
-struct frame_elem* frame_table_find_victim (void);
-void frame_table_delete (uint32_t pd);
+struct frame_elem* frame_table_find_victim (bool* shared);
+void frame_table_delete (struct thread* t);
 void frame_elem_delete (void* target_addr, uint32_t* target_pd);
-size_t frame_table_size (void);
+bool frame_elem_remove (void* target_addr, uint32_t* target_pd);
+bool frame_is_shared (void* kpage);
 
 void swap_lock_acquire (void);
 void swap_lock_release (void);